@@ -0,0 +1,106 @@
+// Память на ключ, заполнение и пропускная способность get:
+// KVStorage (std::map), KVHashStorage и KVCuckooStorage.
+//
+//   bench_cuckoo [keys] [value_size] [threads] [seconds_per_run]
+//
+// Память считается как прирост занятой кучи glibc (mallinfo2) после
+// загрузки, то есть вместе со строками ключей и значений. Заполнение
+// cuckoo-таблицы зависит от того, насколько keys близко к следующему
+// росту: размер таблицы - степень двойки.
+#include "kv_cuckoo_storage.h"
+#include "kv_hash_storage.h"
+#include "kv_storage.h"
+#include "perf_counters.h"
+
+#include <malloc.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+namespace {
+
+size_t heapInUse() { return mallinfo2().uordblks; }
+
+template <typename Storage, typename... Args>
+void run(const char *name, const std::vector<std::string> &keys,
+         size_t value_size, unsigned threads, duration<double> length,
+         Args... args) {
+  auto before = heapInUse();
+  auto storage = std::make_unique<Storage>(
+      std::span<std::tuple<std::string, std::string, uint32_t>>{}, args...);
+  for (auto &key : keys) {
+    storage->set(key, std::string(value_size, 'v'));
+  }
+  double bytes_per_key = static_cast<double>(heapInUse() - before) /
+                         static_cast<double>(keys.size());
+
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> total{0};
+  std::vector<std::thread> workers;
+  kv_bench::PerfCounters perf;
+  perf.start();
+  for (unsigned t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      std::minstd_rand rng(t + 1);
+      uint64_t ops = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        storage->get(keys[rng() % keys.size()]);
+        ++ops;
+      }
+      total += ops;
+    });
+  }
+  std::this_thread::sleep_for(length);
+  stop = true;
+  for (auto &w : workers) {
+    w.join();
+  }
+  perf.stop();
+
+  std::printf("%-16s %12.1f %12.2f", name, bytes_per_key,
+              static_cast<double>(total) / length.count() / 1e6);
+  if constexpr (requires { storage->loadFactor(); }) {
+    std::printf(" %10.1f%%", 100.0 * storage->loadFactor());
+  }
+  std::printf("\n");
+  perf.print(static_cast<double>(total));
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t key_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+  size_t value_size = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 8;
+  unsigned threads = argc > 3 ? static_cast<unsigned>(std::atoi(argv[3]))
+                              : std::thread::hardware_concurrency();
+  duration<double> length(argc > 4 ? std::atof(argv[4]) : 1.0);
+
+  std::vector<std::string> keys;
+  keys.reserve(key_count);
+  for (size_t i = 0; i < key_count; ++i) {
+    keys.push_back("key_" + std::to_string(i));
+  }
+
+  std::printf("keys %zu, value %zu bytes, %u threads\n", key_count,
+              value_size, threads);
+  std::printf("%-16s %12s %12s %11s\n", "engine", "bytes/key", "get Mops/s",
+              "load");
+  run<KVStorage<>>("KVStorage", keys, value_size, threads, length);
+  run<KVHashStorage<>>("KVHashStorage", keys, value_size, threads, length);
+  run<KVCuckooStorage<>>("KVCuckooStorage", keys, value_size, threads,
+                         length);
+  // Без роста таблица не перестраивается.
+  run<KVCuckooStorage<>>("  presized", keys, value_size, threads, length,
+                         steady_clock{},
+                         key_count / KVCuckooStorage<>::kSlotsPerBucket);
+  return 0;
+}
@@ -0,0 +1,158 @@
+// Доля попаданий и пропускная способность: вытеснение по выборке
+// (KVStorageOptions::max_records) против точного LRU со списком.
+//
+//   bench_eviction [keys] [capacity] [threads] [operations_per_thread]
+//
+// Ключи запрашиваются по распределению Зипфа (s = 0.99), при промахе
+// значение записывается в кэш.
+#include "kv_storage.h"
+#include "perf_counters.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std::chrono;
+
+namespace {
+
+class Zipf {
+public:
+  Zipf(size_t n, double s) : cdf_(n) {
+    double sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+      sum += 1.0 / std::pow(static_cast<double>(i + 1), s);
+      cdf_[i] = sum;
+    }
+    for (auto &c : cdf_) {
+      c /= sum;
+    }
+  }
+
+  template <typename Rng> size_t operator()(Rng &rng) const {
+    double u = std::uniform_real_distribution<double>(0, 1)(rng);
+    return static_cast<size_t>(
+        std::lower_bound(begin(cdf_), end(cdf_), u) - begin(cdf_));
+  }
+
+private:
+  std::vector<double> cdf_;
+};
+
+// Точный LRU: каждый get перемещает запись в голову списка, поэтому
+// требует эксклюзивной блокировки.
+class ExactLru {
+public:
+  explicit ExactLru(size_t capacity) : capacity_(capacity) {}
+
+  std::optional<std::string> get(const std::string &key) {
+    std::lock_guard l(mutex_);
+    auto it = index_.find(key);
+    if (it == end(index_)) {
+      return std::nullopt;
+    }
+    order_.splice(begin(order_), order_, it->second);
+    return it->second->second;
+  }
+
+  void set(const std::string &key, std::string value) {
+    std::lock_guard l(mutex_);
+    auto it = index_.find(key);
+    if (it != end(index_)) {
+      it->second->second = std::move(value);
+      order_.splice(begin(order_), order_, it->second);
+      return;
+    }
+    order_.emplace_front(key, std::move(value));
+    index_[key] = begin(order_);
+    if (index_.size() > capacity_) {
+      index_.erase(order_.back().first);
+      order_.pop_back();
+    }
+  }
+
+private:
+  size_t capacity_;
+  std::mutex mutex_;
+  std::list<std::pair<std::string, std::string>> order_;
+  std::unordered_map<std::string,
+                     std::list<std::pair<std::string, std::string>>::iterator>
+      index_;
+};
+
+template <typename Cache>
+void run(const char *name, Cache &cache, const std::vector<std::string> &keys,
+         const Zipf &zipf, unsigned threads, size_t operations) {
+  std::atomic<uint64_t> hits{0};
+  kv_bench::PerfCounters perf;
+  perf.start();
+  auto start = steady_clock::now();
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      std::mt19937_64 rng(t + 1);
+      uint64_t local_hits = 0;
+      for (size_t i = 0; i < operations; ++i) {
+        auto &key = keys[zipf(rng)];
+        if (cache.get(key)) {
+          ++local_hits;
+        } else {
+          cache.set(key, "value");
+        }
+      }
+      hits += local_hits;
+    });
+  }
+  for (auto &w : workers) {
+    w.join();
+  }
+  double seconds = duration<double>(steady_clock::now() - start).count();
+  perf.stop();
+  double total = static_cast<double>(operations) * threads;
+  std::printf("%-16s hit ratio %6.2f%%, %8.2f Mops/s\n", name,
+              100.0 * static_cast<double>(hits) / total,
+              total / seconds / 1e6);
+  perf.print(total);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t key_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+  size_t capacity = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100000;
+  unsigned threads = argc > 3 ? static_cast<unsigned>(std::atoi(argv[3]))
+                              : std::thread::hardware_concurrency();
+  size_t operations = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 500000;
+
+  std::vector<std::string> keys;
+  keys.reserve(key_count);
+  for (size_t i = 0; i < key_count; ++i) {
+    keys.push_back("key_" + std::to_string(i));
+  }
+  Zipf zipf(key_count, 0.99);
+
+  std::printf("keys %zu, capacity %zu, threads %u\n", key_count, capacity,
+              threads);
+  ExactLru lru(capacity);
+  run("exact LRU", lru, keys, zipf, threads, operations);
+  for (uint32_t samples : {3u, 5u, 10u}) {
+    KVStorageOptions options;
+    options.max_records = capacity;
+    options.eviction_samples = samples;
+    KVStorage<> storage({}, steady_clock{}, options);
+    auto name = "sampled K=" + std::to_string(samples);
+    run(name.c_str(), storage, keys, zipf, threads, operations);
+  }
+  return 0;
+}
@@ -0,0 +1,114 @@
+// Задержка get во время массового истечения записей.
+//
+//   bench_expiry [records] [jitter_ms] [expirations_per_second]
+//
+// Все записи загружаются конструктором с одинаковым TTL. Фоновый reaper
+// удаляет истёкшие записи через removeExpiredEntries, читатели замеряют
+// задержку get. Время отсчитывается от конца загрузки. Для каждого
+// интервала 100 мс печатаются p99 и максимум задержки и число удалённых
+// записей.
+#include "kv_storage.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+using namespace std::chrono;
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr auto kTtl = 1s;
+constexpr auto kInterval = 100ms;
+constexpr int kReaders = 2;
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t records = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+  KVStorageOptions options;
+  options.expiry_jitter =
+      milliseconds(argc > 2 ? std::strtoll(argv[2], nullptr, 10) : 0);
+  options.max_expirations_per_second =
+      argc > 3 ? static_cast<uint32_t>(std::strtoul(argv[3], nullptr, 10)) : 0;
+  auto run_for = kTtl + options.expiry_jitter + 1s;
+  size_t intervals = static_cast<size_t>(run_for / kInterval);
+
+  std::vector<std::tuple<std::string, std::string, uint32_t>> entries;
+  entries.reserve(records);
+  for (size_t i = 0; i < records; ++i) {
+    entries.emplace_back("key_" + std::to_string(i), std::string(64, 'v'),
+                         static_cast<uint32_t>(kTtl / 1s));
+  }
+  KVStorage<> storage(entries, steady_clock{}, options);
+  auto start = steady_clock::now();
+
+  auto interval_of = [&](steady_clock::time_point t) {
+    return std::min(intervals - 1, static_cast<size_t>((t - start) / kInterval));
+  };
+
+  std::atomic<bool> stop{false};
+  std::vector<size_t> reclaimed(intervals);
+  std::thread reaper([&] {
+    while (!stop) {
+      size_t n = storage.removeExpiredEntries(256);
+      reclaimed[interval_of(steady_clock::now())] += n;
+      if (n == 0) {
+        std::this_thread::sleep_for(1ms);
+      }
+    }
+  });
+
+  std::mutex latencies_mutex;
+  std::vector<std::vector<double>> latencies(intervals);
+  std::vector<std::thread> readers;
+  for (int r = 0; r < kReaders; ++r) {
+    readers.emplace_back([&, r] {
+      std::minstd_rand rng(r);
+      std::vector<std::vector<double>> local(intervals);
+      while (!stop) {
+        auto key = "key_" + std::to_string(rng() % records);
+        auto t0 = steady_clock::now();
+        storage.get(key);
+        auto t1 = steady_clock::now();
+        local[interval_of(t0)].push_back(
+            duration<double, std::micro>(t1 - t0).count());
+      }
+      std::lock_guard l(latencies_mutex);
+      for (size_t i = 0; i < intervals; ++i) {
+        latencies[i].insert(end(latencies[i]), begin(local[i]), end(local[i]));
+      }
+    });
+  }
+
+  std::this_thread::sleep_until(start + run_for);
+  stop = true;
+  reaper.join();
+  for (auto &t : readers) {
+    t.join();
+  }
+
+  std::printf("records %zu, jitter %lld ms, rate limit %u/s\n", records,
+              static_cast<long long>(options.expiry_jitter.count()),
+              options.max_expirations_per_second);
+  std::printf("%8s %10s %10s %10s\n", "t, ms", "p99, us", "max, us",
+              "reclaimed");
+  for (size_t i = 0; i < intervals; ++i) {
+    auto &l = latencies[i];
+    std::sort(begin(l), end(l));
+    double p99 = l.empty() ? 0 : l[l.size() * 99 / 100];
+    double max = l.empty() ? 0 : l.back();
+    std::printf("%8lld %10.1f %10.1f %10zu\n",
+                static_cast<long long>((i * kInterval).count()), p99, max,
+                reclaimed[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,88 @@
+// Пропускная способность кодирования, декодирования и CRC32C формата
+// kv_format.
+//
+//   bench_format [records] [value_size]
+#include "kv_format.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace std::chrono;
+
+namespace {
+
+constexpr size_t kBlockTarget = 64 * 1024;
+
+template <typename F> double measureSeconds(F &&f) {
+  auto start = steady_clock::now();
+  f();
+  return duration<double>(steady_clock::now() - start).count();
+}
+
+void report(const char *name, size_t bytes, double seconds) {
+  std::printf("%-20s %10.1f MiB/s\n", name,
+              static_cast<double>(bytes) / (1 << 20) / seconds);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t records = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+  size_t value_size = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100;
+
+  std::vector<std::string> keys;
+  keys.reserve(records);
+  for (size_t i = 0; i < records; ++i) {
+    keys.push_back("key_" + std::to_string(i));
+  }
+  std::string value(value_size, 'v');
+
+  std::string file;
+  double encode = measureSeconds([&] {
+    kv_format::appendFileHeader(file);
+    kv_format::BlockBuilder builder;
+    for (size_t i = 0; i < records; ++i) {
+      builder.add(keys[i], value, static_cast<int64_t>(i), i);
+      if (builder.payloadSize() >= kBlockTarget) {
+        builder.finish(file);
+      }
+    }
+    if (!builder.empty()) {
+      builder.finish(file);
+    }
+  });
+
+  size_t decoded = 0;
+  double decode = measureSeconds([&] {
+    size_t offset = 0;
+    std::vector<kv_format::RecordView> views;
+    kv_format::readFileHeader(file, offset);
+    while (kv_format::readBlock(file, offset, views) ==
+           kv_format::Status::Ok) {
+      decoded += views.size();
+      views.clear();
+    }
+  });
+  if (decoded != records) {
+    std::fprintf(stderr, "decoded %zu of %zu records\n", decoded, records);
+    return 1;
+  }
+
+  volatile uint32_t sink = 0;
+  double crc_hw = measureSeconds([&] { sink = kv_format::crc32c(file); });
+  double crc_sw = measureSeconds(
+      [&] { sink = kv_format::crc32cSoftware(file.data(), file.size()); });
+
+  std::printf("records: %zu, value size: %zu, file: %.1f MiB\n", records,
+              value_size, static_cast<double>(file.size()) / (1 << 20));
+  report("encode", file.size(), encode);
+  report("decode+verify", file.size(), decode);
+  report(kv_format::crc32cHardwareAvailable() ? "crc32c sse4.2"
+                                              : "crc32c (no sse4.2)",
+         file.size(), crc_hw);
+  report("crc32c software", file.size(), crc_sw);
+  return 0;
+}
@@ -0,0 +1,98 @@
+// Точечные операции: KVStorage (std::map под одной блокировкой) против
+// KVHashStorage (шарды с хеш-таблицами) при разном числе потоков.
+//
+//   bench_hash [keys] [write_percent] [seconds_per_run] [max_threads]
+#include "kv_hash_storage.h"
+#include "kv_storage.h"
+#include "perf_counters.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+namespace {
+
+template <typename Storage>
+double run(Storage &storage, const std::vector<std::string> &keys,
+           unsigned threads, int write_percent, duration<double> length,
+           kv_bench::PerfCounters &perf) {
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> total{0};
+  std::vector<std::thread> workers;
+  perf.start();
+  for (unsigned t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      std::minstd_rand rng(t + 1);
+      uint64_t ops = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        auto &key = keys[rng() % keys.size()];
+        if (static_cast<int>(rng() % 100) < write_percent) {
+          storage.set(key, "value");
+        } else {
+          storage.get(key);
+        }
+        ++ops;
+      }
+      total += ops;
+    });
+  }
+  std::this_thread::sleep_for(length);
+  stop = true;
+  for (auto &w : workers) {
+    w.join();
+  }
+  perf.stop();
+  return static_cast<double>(total) / length.count() / 1e6;
+}
+
+template <typename Storage>
+double fillAndRun(const std::vector<std::string> &keys, unsigned threads,
+                  int write_percent, duration<double> length,
+                  kv_bench::PerfCounters &perf) {
+  Storage storage({});
+  for (auto &key : keys) {
+    storage.set(key, "value");
+  }
+  return run(storage, keys, threads, write_percent, length, perf);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t key_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+  int write_percent = argc > 2 ? std::atoi(argv[2]) : 10;
+  duration<double> length(argc > 3 ? std::atof(argv[3]) : 1.0);
+  unsigned max_threads = argc > 4 ? static_cast<unsigned>(std::atoi(argv[4]))
+                                  : std::thread::hardware_concurrency() * 2;
+
+  std::vector<std::string> keys;
+  keys.reserve(key_count);
+  for (size_t i = 0; i < key_count; ++i) {
+    keys.push_back("key_" + std::to_string(i));
+  }
+
+  std::printf("keys %zu, %d%% set, Mops/s\n", key_count, write_percent);
+  std::printf("%8s %12s %12s\n", "threads", "KVStorage", "KVHashStorage");
+  for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+    kv_bench::PerfCounters perf;
+    double ordered =
+        fillAndRun<KVStorage<>>(keys, threads, write_percent, length, perf);
+    auto ordered_counters = perf.perOperation(ordered * 1e6 * length.count());
+    double hashed =
+        fillAndRun<KVHashStorage<>>(keys, threads, write_percent, length, perf);
+    std::printf("%8u %12.2f %12.2f\n", threads, ordered, hashed);
+    if (perf.available()) {
+      std::printf("  KVStorage:    %s\n  KVHashStorage:%s\n",
+                  ordered_counters.c_str(),
+                  perf.perOperation(hashed * 1e6 * length.count()).c_str());
+    }
+  }
+  return 0;
+}
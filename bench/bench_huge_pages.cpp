@@ -0,0 +1,97 @@
+// Время get и промахи TLB с индексом на обычных страницах и на 2 МиБ
+// страницах (KVStorageOptions::huge_pages).
+//
+//   bench_huge_pages [keys] [gets]
+//
+// Ключи вставляются в случайном порядке, а читаются равномерно случайно,
+// поэтому путь по дереву касается страниц по всему индексу. Промахи
+// dTLB видны с KV_PERF=1 там, где доступны аппаратные счётчики.
+#include "kv_storage.h"
+#include "perf_counters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std::chrono;
+
+namespace {
+
+std::string keyOf(size_t i) { return "key:" + std::to_string(i * 7919); }
+
+// AnonHugePages процесса в КиБ: сколько памяти реально на THP.
+long anonHugePagesKb() {
+  std::ifstream in("/proc/self/smaps_rollup");
+  for (std::string line; std::getline(in, line);) {
+    if (line.rfind("AnonHugePages:", 0) == 0) {
+      return std::strtol(line.c_str() + 14, nullptr, 10);
+    }
+  }
+  return -1;
+}
+
+void run(bool huge_pages, size_t keys, size_t gets) {
+  std::vector<size_t> order(keys);
+  for (size_t i = 0; i < keys; ++i) {
+    order[i] = i;
+  }
+  std::shuffle(begin(order), end(order), std::mt19937_64(1));
+
+  KVStorageOptions options;
+  options.huge_pages = huge_pages;
+  KVStorage<> storage({}, steady_clock{}, options);
+  for (auto i : order) {
+    storage.set(keyOf(i), "value");
+  }
+  auto thp_kb = anonHugePagesKb();
+
+  std::minstd_rand rng(42);
+  // Заранее построенные ключи, чтобы не мерить форматирование.
+  std::vector<std::string> probes(std::min<size_t>(gets, 1 << 18));
+  for (auto &probe : probes) {
+    probe = keyOf(rng() % keys);
+  }
+
+  kv_bench::PerfCounters perf;
+  std::vector<double> latencies;
+  latencies.reserve(gets / 64 + 1);
+  size_t found = 0;
+  perf.start();
+  auto start = steady_clock::now();
+  for (size_t i = 0; i < gets; i += 64) {
+    auto batch = steady_clock::now();
+    for (size_t j = 0; j < 64; ++j) {
+      found += storage.get(probes[(i + j) % probes.size()]).has_value();
+    }
+    latencies.push_back(
+        duration<double, std::nano>(steady_clock::now() - batch).count() / 64);
+  }
+  double ns = duration<double, std::nano>(steady_clock::now() - start).count();
+  perf.stop();
+  std::sort(begin(latencies), end(latencies));
+
+  auto stats = storage.hugePageStats();
+  std::printf("%-10s %8.1f ns/get  p50 %7.1f  p99 %7.1f  (%zu found)\n",
+              huge_pages ? "huge" : "regular", ns / static_cast<double>(gets),
+              latencies[latencies.size() / 2],
+              latencies[latencies.size() * 99 / 100], found);
+  std::printf("           hugetlb %zu MiB, thp %zu MiB, regular %zu MiB, "
+              "AnonHugePages %ld KiB\n",
+              stats.explicit_bytes >> 20, stats.transparent_bytes >> 20,
+              stats.regular_bytes >> 20, thp_kb);
+  perf.print(static_cast<double>(gets));
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t keys = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+  size_t gets = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 4000000;
+  run(false, keys, gets);
+  run(true, keys, gets);
+}
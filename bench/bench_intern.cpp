@@ -0,0 +1,72 @@
+// Память и время set с разделяемыми значениями
+// (KVStorageOptions::intern_max_value_size) и без них.
+//
+//   bench_intern [keys] [distinct_values]
+//
+// Значения - строки статусов длиннее буфера SSO, по distinct_values
+// различных. Память считается как прирост занятой кучи glibc (mallinfo2).
+#include "kv_storage.h"
+
+#include <malloc.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace std::chrono;
+
+namespace {
+
+size_t heapInUse() { return mallinfo2().uordblks; }
+
+void run(size_t intern_max, const std::vector<std::string> &keys,
+         const std::vector<std::string> &values) {
+  auto before = heapInUse();
+  KVStorageOptions options;
+  options.intern_max_value_size = intern_max;
+  KVStorage<> storage({}, steady_clock{}, options);
+
+  auto start = steady_clock::now();
+  for (size_t i = 0; i < keys.size(); ++i) {
+    storage.set(keys[i], values[i % values.size()]);
+  }
+  double set_ns =
+      duration<double, std::nano>(steady_clock::now() - start).count();
+  auto heap = heapInUse() - before;
+
+  start = steady_clock::now();
+  size_t bytes = 0;
+  for (auto &key : keys) {
+    bytes += storage.get(key)->size();
+  }
+  double get_ns =
+      duration<double, std::nano>(steady_clock::now() - start).count();
+
+  auto stats = storage.internStats();
+  auto n = static_cast<double>(keys.size());
+  std::printf("%-8s %7.1f ns/set %7.1f ns/get %7.1f B/key  "
+              "(%zu shared, %zu MiB saved, %zu value bytes)\n",
+              intern_max ? "intern" : "plain", set_ns / n, get_ns / n,
+              static_cast<double>(heap) / n, stats.values,
+              stats.bytes_saved >> 20, bytes);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+  size_t distinct = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 8;
+
+  std::vector<std::string> keys;
+  for (size_t i = 0; i < count; ++i) {
+    keys.push_back("order:" + std::to_string(i * 7919));
+  }
+  std::vector<std::string> values;
+  for (size_t i = 0; i < distinct; ++i) {
+    values.push_back("STATUS_AWAITING_REVIEW_" + std::to_string(i));
+  }
+  run(0, keys, values);
+  run(64, keys, values);
+}
@@ -0,0 +1,95 @@
+// Время get до и после KVStorage::relayout по подсказке из записанной
+// трассы.
+//
+//   bench_layout [groups] [gets]
+//
+// Ключи образуют группы по 4 (профиль, настройки, ...), которые читаются
+// вместе. Ключи вставляются в случайном порядке вперемешку с другими
+// выделениями памяти, поэтому узлы одной группы разбросаны по куче.
+#include "kv_access.h"
+#include "kv_storage.h"
+#include "perf_counters.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std::chrono;
+
+namespace {
+
+constexpr const char *kParts[] = {"profile", "settings", "avatar", "session"};
+
+std::string keyOf(size_t group, size_t part) {
+  return "user:" + std::to_string(group * 7919 % 1000003) + ":" + kParts[part];
+}
+
+long minorFaults() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_minflt;
+}
+
+template <typename Storage>
+void measure(const char *name, Storage &storage, size_t groups, size_t gets) {
+  std::minstd_rand rng(42);
+  kv_bench::PerfCounters perf;
+  auto faults = minorFaults();
+  perf.start();
+  auto start = steady_clock::now();
+  size_t found = 0;
+  for (size_t i = 0; i < gets; i += 4) {
+    size_t group = rng() % groups;
+    for (size_t part = 0; part < 4; ++part) {
+      found += storage.get(keyOf(group, part)).has_value();
+    }
+  }
+  double ns = duration<double, std::nano>(steady_clock::now() - start).count();
+  perf.stop();
+  std::printf("%-16s %10.1f ns/get %10ld minor faults (%zu found)\n", name,
+              ns / static_cast<double>(gets), minorFaults() - faults, found);
+  perf.print(static_cast<double>(gets));
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t groups = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 50000;
+  size_t gets = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 2000000;
+
+  std::vector<std::pair<size_t, size_t>> order;
+  for (size_t g = 0; g < groups; ++g) {
+    for (size_t p = 0; p < 4; ++p) {
+      order.emplace_back(g, p);
+    }
+  }
+  std::shuffle(begin(order), end(order), std::mt19937_64(1));
+
+  KVStorageOptions options;
+  options.access_sample_one_in = 16;
+  options.access_sequence_length = 16;
+  options.access_max_sequences = 1 << 20;
+  KVStorage<> storage({}, steady_clock{}, options);
+  std::vector<std::unique_ptr<char[]>> noise;
+  for (auto [g, p] : order) {
+    storage.set(keyOf(g, p), std::string(24, 'v'));
+    noise.push_back(std::make_unique<char[]>(64));
+  }
+  noise.clear();
+
+  measure("before relayout", storage, groups, gets);
+  auto sequences = storage.accessRecorder()->sequences();
+  auto hint = kv_access::buildLayout(sequences);
+  std::printf("%zu sequences, %zu keys in hint\n", sequences.size(),
+              hint.size());
+  storage.relayout(hint);
+  measure("after relayout", storage, groups, gets);
+  return 0;
+}
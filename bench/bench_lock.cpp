@@ -0,0 +1,104 @@
+// Сравнение политик блокировки KVStorage при разной доле записей.
+//
+//   bench_lock [threads] [seconds_per_run]
+#include "kv_lock_elision.h"
+#include "kv_rw_lock.h"
+#include "kv_storage.h"
+#include "perf_counters.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+namespace {
+
+constexpr size_t kKeys = 100000;
+constexpr int kWritePercents[] = {0, 5, 50};
+
+template <typename Lock>
+double run(unsigned threads, int write_percent, duration<double> length,
+           kv_bench::PerfCounters &perf) {
+  KVStorage<steady_clock, Lock> storage({});
+  std::vector<std::string> keys;
+  for (size_t i = 0; i < kKeys; ++i) {
+    keys.push_back("key_" + std::to_string(i));
+    storage.set(keys.back(), "value");
+  }
+
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> total{0};
+  std::vector<std::thread> workers;
+  perf.start();
+  for (unsigned t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      std::minstd_rand rng(t + 1);
+      uint64_t ops = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        auto &key = keys[rng() % kKeys];
+        if (static_cast<int>(rng() % 100) < write_percent) {
+          storage.set(key, "value");
+        } else {
+          storage.get(key);
+        }
+        ++ops;
+      }
+      total += ops;
+    });
+  }
+  std::this_thread::sleep_for(length);
+  stop = true;
+  for (auto &w : workers) {
+    w.join();
+  }
+  perf.stop();
+  return static_cast<double>(total) / length.count() / 1e6;
+}
+
+template <typename Lock>
+void runAll(const char *name, unsigned threads, duration<double> length) {
+  kv_bench::PerfCounters perf;
+  std::vector<std::string> counters;
+  std::printf("%-28s", name);
+  for (int write_percent : kWritePercents) {
+    double mops = run<Lock>(threads, write_percent, length, perf);
+    std::printf(" %10.2f", mops);
+    counters.push_back(perf.perOperation(mops * 1e6 * length.count()));
+  }
+  std::printf("\n");
+  if (perf.available()) {
+    for (size_t i = 0; i < counters.size(); ++i) {
+      std::printf("  %2d%% set:%s\n", kWritePercents[i], counters[i].c_str());
+    }
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  unsigned threads = argc > 1 ? static_cast<unsigned>(std::atoi(argv[1]))
+                              : std::thread::hardware_concurrency();
+  duration<double> length(argc > 2 ? std::atof(argv[2]) : 1.0);
+
+  std::printf("threads: %u, Mops/s\n", threads);
+  std::printf("%-28s %10s %10s %10s\n", "lock", "0% set", "5% set",
+              "50% set");
+  runAll<std::shared_mutex>("std::shared_mutex", threads, length);
+  runAll<kv_lock::AdaptiveSharedMutex>("AdaptiveSharedMutex", threads, length);
+  runAll<kv_lock::BravoSharedMutex<>>("BravoSharedMutex<Adaptive>", threads,
+                                      length);
+  if (kv_lock::RtmBackend::available()) {
+    runAll<kv_lock::ElidedSharedMutex<>>("ElidedSharedMutex<RTM>", threads,
+                                         length);
+  } else {
+    std::printf("%-28s no RTM on this CPU\n", "ElidedSharedMutex<RTM>");
+  }
+  return 0;
+}
@@ -0,0 +1,117 @@
+// Пропускная способность getMany и getManySorted в зависимости от
+// KVStorageOptions::prefetch_group и coroutine_lookups на наборе данных
+// больше LLC. Первая строка - обычный цикл get по тем же ключам.
+//
+//   bench_prefetch [keys] [operations]
+//
+// Ключи вставляются в случайном порядке, поэтому соседние по порядку узлы
+// дерева и их значения разбросаны по куче.
+#include "kv_storage.h"
+#include "perf_counters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std::chrono;
+
+namespace {
+
+constexpr size_t kBatch = 32;
+constexpr uint32_t kScanLength = 1000;
+
+std::string keyOf(size_t i) { return "key:" + std::to_string(i * 7919); }
+
+void run(uint32_t group, bool coroutines, size_t keys, size_t operations) {
+  std::vector<size_t> order(keys);
+  for (size_t i = 0; i < keys; ++i) {
+    order[i] = i;
+  }
+  std::shuffle(begin(order), end(order), std::mt19937_64(1));
+
+  KVStorageOptions options;
+  options.prefetch_group = group;
+  options.coroutine_lookups = coroutines;
+  KVStorage<> storage({}, steady_clock{}, options);
+  for (auto i : order) {
+    storage.set(keyOf(i), std::string(64, 'v'));
+  }
+
+  std::minstd_rand rng(42);
+  // Ключи короче SSO, массив читается последовательно и мешает мало.
+  std::vector<std::string> probes(std::min<size_t>(operations, 1 << 20));
+  for (auto &probe : probes) {
+    probe = keyOf(rng() % keys);
+  }
+  std::vector<std::string_view> batch(kBatch);
+
+  kv_bench::PerfCounters perf;
+  auto start = steady_clock::now();
+  size_t found = 0;
+  double seconds = 0;
+  if (group == 0) {
+    perf.start();
+    for (size_t i = 0; i < operations; ++i) {
+      found += storage.get(probes[i % probes.size()]).has_value();
+    }
+    seconds = duration<double>(steady_clock::now() - start).count();
+    perf.stop();
+    std::printf("get loop            %8.2f M keys/s (%zu found)\n",
+                static_cast<double>(operations) / seconds / 1e6, found);
+    perf.print(static_cast<double>(operations));
+    found = 0;
+  }
+
+  const char *mode = coroutines ? "coroutines" : "group";
+  perf.start();
+  start = steady_clock::now();
+  for (size_t i = 0; i < operations; i += kBatch) {
+    for (size_t j = 0; j < kBatch; ++j) {
+      batch[j] = probes[(i + j) % probes.size()];
+    }
+    for (auto &value : storage.getMany(batch)) {
+      found += value.has_value();
+    }
+  }
+  seconds = duration<double>(steady_clock::now() - start).count();
+  perf.stop();
+  std::printf("%-10s %-3u getMany %8.2f M keys/s (%zu found)\n", mode,
+              group, static_cast<double>(operations) / seconds / 1e6, found);
+  perf.print(static_cast<double>(operations));
+  if (coroutines) {
+    return;
+  }
+
+  size_t scans = std::max<size_t>(operations / kScanLength, 1);
+  size_t records = 0;
+  perf.start();
+  start = steady_clock::now();
+  for (size_t i = 0; i < scans; ++i) {
+    records += storage.getManySorted(probes[i % probes.size()], kScanLength)
+                   .size();
+  }
+  seconds = duration<double>(steady_clock::now() - start).count();
+  perf.stop();
+  std::printf("%-10s %-3u scan    %8.2f M records/s\n", mode, group,
+              static_cast<double>(records) / seconds / 1e6);
+  perf.print(static_cast<double>(records));
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t keys = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4000000;
+  size_t operations =
+      argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 4000000;
+  for (uint32_t group : {0u, 4u, 8u, 16u}) {
+    run(group, false, keys, operations);
+  }
+  for (uint32_t lanes : {8u, 16u}) {
+    run(lanes, true, keys, operations);
+  }
+}
@@ -0,0 +1,92 @@
+// Задержка set при параллельных длинных getManySorted для разных
+// KVStorageOptions::scan_chunk_size.
+//
+//   bench_scan [records] [scan_length] [scanners] [seconds_per_run]
+//
+// Писатель перезаписывает случайные ключи и замеряет задержку set,
+// сканеры непрерывно читают scan_length записей с начала диапазона.
+#include "kv_storage.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+using namespace std::chrono;
+
+namespace {
+
+void run(uint32_t chunk, size_t records, uint32_t scan_length,
+         unsigned scanners, duration<double> length) {
+  std::vector<std::tuple<std::string, std::string, uint32_t>> entries;
+  entries.reserve(records);
+  for (size_t i = 0; i < records; ++i) {
+    entries.emplace_back("key_" + std::to_string(i), std::string(32, 'v'), 0);
+  }
+  KVStorageOptions options;
+  options.scan_chunk_size = chunk;
+  KVStorage<> storage(entries, steady_clock{}, options);
+
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> scans{0};
+  std::vector<std::thread> threads;
+  for (unsigned s = 0; s < scanners; ++s) {
+    threads.emplace_back([&] {
+      while (!stop) {
+        storage.getManySorted("", scan_length);
+        ++scans;
+      }
+    });
+  }
+
+  std::vector<double> latencies;
+  std::minstd_rand rng(1);
+  auto end_time = steady_clock::now() + length;
+  while (steady_clock::now() < end_time) {
+    auto key = "key_" + std::to_string(rng() % records);
+    auto t0 = steady_clock::now();
+    storage.set(std::move(key), std::string(32, 'w'));
+    latencies.push_back(
+        duration<double, std::micro>(steady_clock::now() - t0).count());
+  }
+  stop = true;
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  std::sort(begin(latencies), end(latencies));
+  auto percentile = [&](double p) {
+    return latencies[static_cast<size_t>(p * (latencies.size() - 1))];
+  };
+  std::printf("%10u %10zu %10.1f %10.1f %10.1f %10.1f\n", chunk,
+              latencies.size(), percentile(0.5), percentile(0.99),
+              latencies.back(),
+              static_cast<double>(scans) / length.count());
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t records = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+  uint32_t scan_length =
+      argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10))
+               : 100000;
+  unsigned scanners =
+      argc > 3 ? static_cast<unsigned>(std::atoi(argv[3])) : 2;
+  duration<double> length(argc > 4 ? std::atof(argv[4]) : 1.0);
+
+  std::printf("records %zu, scan %u, scanners %u; set latency in us\n",
+              records, scan_length, scanners);
+  std::printf("%10s %10s %10s %10s %10s %10s\n", "chunk", "sets", "p50",
+              "p99", "max", "scans/s");
+  for (uint32_t chunk : {0u, 16384u, 1024u, 64u}) {
+    run(chunk, records, scan_length, scanners, length);
+  }
+  return 0;
+}
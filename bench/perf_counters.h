@@ -0,0 +1,166 @@
+#pragma once
+
+// Аппаратные счётчики для бенчмарков через perf_event_open. Включаются
+// переменной окружения KV_PERF=1; без неё, вне Linux, или если ядро
+// не даёт открыть счётчик (контейнеры, perf_event_paranoid), бенчмарки
+// печатают только свои обычные числа.
+//
+// Счётчики открываются по отдельности (не группой) с inherit, чтобы
+// учитывать потоки, созданные после start(). Значения потока попадают в
+// счётчик при его завершении, поэтому stop() вызывается после join.
+// При мультиплексировании значения масштабируются по
+// time_enabled / time_running.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace kv_bench {
+
+class PerfCounters {
+public:
+  PerfCounters() {
+    if (!enabled()) {
+      return;
+    }
+#ifdef __linux__
+    open("cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    open("instr", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    open("LLC-miss", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    open("br-miss", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    open("dTLB-miss", PERF_TYPE_HW_CACHE,
+         PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    // Программный счётчик обычно доступен и там, где аппаратных нет.
+    open("faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+#endif
+    if (missing_ != 0) {
+      warnOnce(missing_);
+    }
+  }
+
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  ~PerfCounters() {
+#ifdef __linux__
+    for (auto &counter : counters_) {
+      close(counter.fd);
+    }
+#endif
+  }
+
+  static bool enabled() {
+    static const bool on = [] {
+      auto *value = std::getenv("KV_PERF");
+      return value && std::strcmp(value, "0") != 0 && *value != '\0';
+    }();
+    return on;
+  }
+
+  bool available() const { return !counters_.empty(); }
+
+  void start() {
+#ifdef __linux__
+    for (auto &counter : counters_) {
+      ioctl(counter.fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(counter.fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  void stop() {
+#ifdef __linux__
+    for (auto &counter : counters_) {
+      ioctl(counter.fd, PERF_EVENT_IOC_DISABLE, 0);
+      uint64_t values[3] = {};
+      if (read(counter.fd, values, sizeof(values)) != sizeof(values) ||
+          values[2] == 0) {
+        counter.value = -1;
+        continue;
+      }
+      counter.value = static_cast<double>(values[0]) *
+                      static_cast<double>(values[1]) /
+                      static_cast<double>(values[2]);
+    }
+#endif
+  }
+
+  // Строка вида "  cycles/op 812.3  instr/op 1021 ..." для значений
+  // последнего интервала start/stop; пусто, если счётчиков нет.
+  std::string perOperation(double operations) const {
+    std::string out;
+    char buf[64];
+    for (auto &counter : counters_) {
+      if (counter.value < 0 || operations <= 0) {
+        std::snprintf(buf, sizeof(buf), "  %s/op n/a", counter.name);
+      } else {
+        std::snprintf(buf, sizeof(buf), "  %s/op %.4g", counter.name,
+                      counter.value / operations);
+      }
+      out += buf;
+    }
+    return out;
+  }
+
+  void print(double operations) const {
+    if (available()) {
+      std::printf("%s\n", perOperation(operations).c_str());
+    }
+  }
+
+private:
+  struct Counter {
+    const char *name;
+    int fd;
+    double value = -1;
+  };
+
+#ifdef __linux__
+  void open(const char *name, uint32_t type, uint64_t config) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    auto fd = static_cast<int>(
+        syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    if (fd >= 0) {
+      counters_.push_back({name, fd});
+    } else {
+      ++missing_;
+    }
+  }
+#endif
+
+  static void warnOnce(int missing) {
+    static bool warned = false;
+    if (!warned) {
+      warned = true;
+      std::fprintf(stderr,
+                   "KV_PERF: %d counter(s) unavailable "
+                   "(perf_event_open failed), reporting the rest\n",
+                   missing);
+    }
+  }
+
+  std::vector<Counter> counters_;
+  int missing_ = 0;
+};
+
+} // namespace kv_bench
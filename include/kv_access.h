@@ -0,0 +1,256 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "kv_thread_state.h"
+
+// Запись последовательностей обращений к ключам и построение по ним
+// порядка размещения, в котором совместно читаемые ключи лежат рядом
+// (см. KVStorage::relayout).
+namespace kv_access {
+
+// Сэмплирует последовательности get: примерно раз в sample_one_in
+// обращений поток начинает записывать свои следующие sequence_length
+// ключей. Вне выборки record стоит одного декремента thread_local
+// счётчика. Хранится не больше max_sequences последовательностей.
+class AccessRecorder {
+public:
+  explicit AccessRecorder(uint32_t sample_one_in,
+                          uint32_t sequence_length = 16,
+                          size_t max_sequences = 4096)
+      : sample_one_in_(std::max(sample_one_in, 1u)),
+        sequence_length_(std::max(sequence_length, 2u)),
+        max_sequences_(max_sequences) {}
+
+  void record(std::string_view key) {
+    // Незаконченная последовательность вытесненного состояния теряется.
+    auto &state = thread_states_.get(
+        [&] { return ThreadState{sample_one_in_, {}}; });
+    if (state.current.empty()) {
+      if (--state.countdown != 0) {
+        return;
+      }
+      state.countdown = sample_one_in_;
+    }
+    state.current.emplace_back(key);
+    if (state.current.size() == sequence_length_) {
+      std::lock_guard l(mutex_);
+      if (sequences_.size() < max_sequences_) {
+        sequences_.push_back(std::move(state.current));
+      }
+      state.current.clear();
+    }
+  }
+
+  std::vector<std::vector<std::string>> sequences() const {
+    std::lock_guard l(mutex_);
+    return sequences_;
+  }
+
+  void clear() {
+    std::lock_guard l(mutex_);
+    sequences_.clear();
+  }
+
+private:
+  struct ThreadState {
+    uint32_t countdown = 0;
+    std::vector<std::string> current;
+  };
+
+  uint32_t sample_one_in_;
+  uint32_t sequence_length_;
+  size_t max_sequences_;
+  kv_thread::PerThreadState<ThreadState> thread_states_;
+  mutable std::mutex mutex_;
+  std::vector<std::vector<std::string>> sequences_;
+};
+
+// Ключи в файлах трассы и подсказок экранируются как в kv_dump:
+// непечатные байты, пробел и '\' записываются как \xHH.
+inline std::string escape(std::string_view key) {
+  std::string out;
+  for (unsigned char c : key) {
+    if (c > 0x20 && c < 0x7F && c != '\\') {
+      out += static_cast<char>(c);
+    } else {
+      char buf[5];
+      std::snprintf(buf, sizeof(buf), "\\x%02X", c);
+      out += buf;
+    }
+  }
+  return out;
+}
+
+inline bool unescape(std::string_view text, std::string &key) {
+  key.clear();
+  for (size_t i = 0; i < text.size(); ++i) {
+    if (text[i] != '\\') {
+      key += text[i];
+      continue;
+    }
+    if (i + 3 >= text.size() || text[i + 1] != 'x') {
+      return false;
+    }
+    unsigned value = 0;
+    for (size_t j = i + 2; j < i + 4; ++j) {
+      char c = text[j];
+      if (c >= '0' && c <= '9') {
+        value = value * 16 + static_cast<unsigned>(c - '0');
+      } else if (c >= 'A' && c <= 'F') {
+        value = value * 16 + static_cast<unsigned>(c - 'A' + 10);
+      } else {
+        return false;
+      }
+    }
+    key += static_cast<char>(value);
+    i += 3;
+  }
+  return true;
+}
+
+// Трасса: по последовательности на строку, ключи через пробел.
+inline std::error_code
+saveSequences(const std::string &path,
+              const std::vector<std::vector<std::string>> &sequences) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  for (auto &sequence : sequences) {
+    for (size_t i = 0; i < sequence.size(); ++i) {
+      out << (i ? " " : "") << escape(sequence[i]);
+    }
+    out << '\n';
+  }
+  out.flush();
+  return out ? std::error_code{}
+             : std::make_error_code(std::errc::io_error);
+}
+
+inline std::error_code
+loadSequences(const std::string &path,
+              std::vector<std::vector<std::string>> &sequences) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    return std::make_error_code(std::errc::no_such_file_or_directory);
+  }
+  std::string line;
+  std::string key;
+  while (std::getline(in, line)) {
+    std::vector<std::string> sequence;
+    std::istringstream words(line);
+    for (std::string word; words >> word;) {
+      if (!unescape(word, key)) {
+        return std::make_error_code(std::errc::illegal_byte_sequence);
+      }
+      sequence.push_back(key);
+    }
+    sequences.push_back(std::move(sequence));
+  }
+  return {};
+}
+
+// Подсказка: ключи по одному на строку в порядке размещения.
+inline std::error_code saveHint(const std::string &path,
+                                const std::vector<std::string> &order) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  for (auto &key : order) {
+    out << escape(key) << '\n';
+  }
+  out.flush();
+  return out ? std::error_code{}
+             : std::make_error_code(std::errc::io_error);
+}
+
+inline std::error_code loadHint(const std::string &path,
+                                std::vector<std::string> &order) {
+  std::vector<std::vector<std::string>> lines;
+  if (auto error = loadSequences(path, lines)) {
+    return error;
+  }
+  for (auto &line : lines) {
+    if (line.size() == 1) {
+      order.push_back(std::move(line[0]));
+    }
+  }
+  return {};
+}
+
+// Порядок размещения по трассе. Вес пары ключей - сколько раз они
+// встретились в одной последовательности на расстоянии меньше window.
+// Группы строятся жадно: от самого «тяжёлого» ещё не размещённого ключа
+// к соседу с наибольшей суммарной связью с группой, пока связи не
+// кончатся или в группе не наберётся max_group ключей (узлы группы
+// должны уместиться в несколько страниц). Ключи без связей в порядок не
+// попадают.
+inline std::vector<std::string>
+buildLayout(const std::vector<std::vector<std::string>> &sequences,
+            size_t window = 4, size_t max_group = 32) {
+  using Neighbours = std::unordered_map<std::string_view, uint32_t>;
+  std::unordered_map<std::string_view, Neighbours> graph;
+  for (auto &sequence : sequences) {
+    for (size_t i = 0; i < sequence.size(); ++i) {
+      for (size_t j = i + 1; j < sequence.size() && j < i + window; ++j) {
+        if (sequence[i] != sequence[j]) {
+          ++graph[sequence[i]][sequence[j]];
+          ++graph[sequence[j]][sequence[i]];
+        }
+      }
+    }
+  }
+
+  std::vector<std::pair<uint64_t, std::string_view>> seeds;
+  for (auto &[key, neighbours] : graph) {
+    uint64_t total = 0;
+    for (auto &[_, weight] : neighbours) {
+      total += weight;
+    }
+    seeds.emplace_back(total, key);
+  }
+  std::sort(begin(seeds), end(seeds), [](auto &a, auto &b) {
+    return a.first != b.first ? a.first > b.first : a.second < b.second;
+  });
+
+  std::vector<std::string> order;
+  std::unordered_set<std::string_view> placed;
+  for (auto &[_, seed] : seeds) {
+    if (placed.count(seed)) {
+      continue;
+    }
+    // Связь кандидатов с уже размещёнными ключами группы.
+    std::unordered_map<std::string_view, uint64_t> frontier;
+    std::optional<std::string_view> key = seed;
+    for (size_t size = 0; key && size < max_group; ++size) {
+      order.emplace_back(*key);
+      placed.insert(*key);
+      frontier.erase(*key);
+      for (auto &[neighbour, weight] : graph[*key]) {
+        if (!placed.count(neighbour)) {
+          frontier[neighbour] += weight;
+        }
+      }
+      key.reset();
+      uint64_t best = 0;
+      for (auto &[candidate, weight] : frontier) {
+        if (weight > best || (weight == best && candidate < *key)) {
+          best = weight;
+          key = candidate;
+        }
+      }
+    }
+  }
+  return order;
+}
+
+} // namespace kv_access
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <mutex>
+
+// Ограничение скорости записи в KVStorage.
+namespace kv_admission {
+
+// Токен-бакет: пополняется со скоростью rate токенов в секунду, вмещает
+// не больше burst. Время передаётся снаружи в секундах (KVStorage берёт
+// его от steady_clock). rate == 0 - ограничения нет.
+class TokenBucket {
+public:
+  TokenBucket() = default;
+  TokenBucket(double rate, double burst)
+      : rate_(rate), burst_(std::max(burst, 1.0)), tokens_(burst_) {}
+
+  bool enabled() const { return rate_ > 0; }
+
+  // Берёт cost токенов, если они есть.
+  bool tryTake(double cost, double now) {
+    if (!enabled()) {
+      return true;
+    }
+    std::lock_guard l(mutex_);
+    refill(now);
+    // Запись дороже всего бакета пропускается при полном бакете, иначе
+    // она не прошла бы никогда.
+    if (tokens_ < std::min(cost, burst_)) {
+      return false;
+    }
+    tokens_ -= cost;
+    return true;
+  }
+
+  // Берёт cost токенов, при нехватке уходя в долг. Возвращает время в
+  // секундах, через которое долг будет погашен (0, если токенов хватило).
+  double reserve(double cost, double now) {
+    if (!enabled()) {
+      return 0;
+    }
+    std::lock_guard l(mutex_);
+    refill(now);
+    tokens_ -= cost;
+    return tokens_ >= 0 ? 0 : -tokens_ / rate_;
+  }
+
+  void refund(double cost) {
+    if (!enabled()) {
+      return;
+    }
+    std::lock_guard l(mutex_);
+    tokens_ = std::min(burst_, tokens_ + cost);
+  }
+
+private:
+  void refill(double now) {
+    if (now > last_) {
+      tokens_ = std::min(burst_, tokens_ + (now - last_) * rate_);
+      last_ = now;
+    }
+  }
+
+  double rate_ = 0;
+  double burst_ = 1;
+  double tokens_ = 1;
+  double last_ = 0;
+  std::mutex mutex_;
+};
+
+} // namespace kv_admission
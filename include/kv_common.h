@@ -0,0 +1,74 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <tuple>
+
+// Общее для движков KVStorage, KVHashStorage и KVCuckooStorage: хеш ключа
+// и кодирование сроков истечения, которое у них должно совпадать.
+namespace kv_common {
+
+// Сроки хранятся в тиках Clock::duration от эпохи хранилища. kNoExpiry
+// больше любого достижимого тика, поэтому проверка истечения - одно
+// сравнение expiry <= now.
+inline constexpr uint64_t kNoExpiry = std::numeric_limits<uint64_t>::max();
+
+// Часы хранилища вместе с его эпохой (моментом создания).
+template <typename Clock> class TickClock {
+public:
+  using duration = typename Clock::duration;
+  using time_point = typename Clock::time_point;
+
+  explicit TickClock(Clock clock) : clock_(clock), epoch_(clock_.now()) {}
+
+  time_point now() const { return clock_.now(); }
+
+  // Моменты до эпохи - тик 0.
+  uint64_t toTick(time_point tp) const {
+    auto ticks = (tp - epoch_).count();
+    return ticks > 0 ? static_cast<uint64_t>(ticks) : 0;
+  }
+
+  uint64_t nowTick() const { return toTick(now()); }
+
+  // Тик истечения через ttl (округлённый вверх до Clock::duration) плюс
+  // extra. Нулевой TTL - запись без истечения.
+  template <typename Rep, typename Period>
+  uint64_t expiryAfter(std::chrono::duration<Rep, Period> ttl,
+                       duration extra = duration::zero()) const {
+    if (ttl == ttl.zero()) {
+      return kNoExpiry;
+    }
+    return toTick(now() + std::chrono::ceil<duration>(ttl) + extra);
+  }
+
+private:
+  Clock clock_;
+  time_point epoch_;
+};
+
+// Элемент очереди сроков: по возрастанию срока, при равных - по ключу.
+struct ExpiryEntry {
+  uint64_t expiry;
+  std::string key;
+
+  bool operator<(const ExpiryEntry &other) const {
+    return std::tie(expiry, key) < std::tie(other.expiry, other.key);
+  }
+};
+
+// Перемешивание поверх std::hash: у libstdc++ это murmur, но младшие и
+// старшие биты нужны независимыми (индекс и шард/метка).
+inline uint64_t hashOf(std::string_view key) {
+  uint64_t h = std::hash<std::string_view>{}(key);
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return h;
+}
+
+} // namespace kv_common
@@ -0,0 +1,635 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "kv_common.h"
+
+// Движок на cuckoo-хешировании для плотного хранения точечных данных
+// (как MemC3/libcuckoo). Бакеты по 4 слота, у каждого слота 8-битная
+// метка хеша; 4 метки бакета лежат в одном 32-битном слове и сравниваются
+// за раз (SWAR). У ключа два бакета: основной по хешу и альтернативный
+// по метке, поэтому запись можно переложить, не зная ключа. Вставка в
+// полные бакеты освобождает место, сдвигая записи по найденному поиском
+// в ширину пути; это держит заполнение выше 90%.
+//
+// Писатель один (writer_mutex_). Читатели не блокируются: они сверяют
+// счётчики версий бакетов до и после чтения и повторяют попытку, если
+// писатель успел изменить бакет. Записи неизменяемы: заголовок, ключ и
+// значение одним куском в арене, слот - указатель на него. Заменённые и
+// удалённые записи, как и таблица после роста вдвое, освобождаются по
+// эпохам (epoch-based reclamation): только когда ушли все читатели,
+// начавшие чтение до снятия записи.
+template <typename Clock = std::chrono::steady_clock> class KVCuckooStorage {
+public:
+  static constexpr uint64_t kNoExpiry = kv_common::kNoExpiry;
+  static constexpr size_t kSlotsPerBucket = 4;
+
+  explicit KVCuckooStorage(
+      std::span<std::tuple<std::string, std::string, uint32_t>> entries,
+      Clock clock = Clock{}, size_t initial_buckets = 16)
+      : clock_(clock) {
+    current_ = std::make_unique<Table>(
+        std::bit_ceil(std::max<size_t>(initial_buckets, 2)));
+    table_.store(current_.get(), std::memory_order_release);
+    for (auto &[key, value, ttl] : entries) {
+      set(key, value, ttl);
+    }
+  }
+
+  KVCuckooStorage(const KVCuckooStorage &) = delete;
+  KVCuckooStorage &operator=(const KVCuckooStorage &) = delete;
+
+  ~KVCuckooStorage() {
+    auto &table = *table_.load(std::memory_order_relaxed);
+    for (size_t b = 0; b <= table.mask; ++b) {
+      for (auto &slot : table.buckets[b].slots) {
+        if (auto *entry = slot.load(std::memory_order_relaxed)) {
+          release(entry);
+        }
+      }
+    }
+    for (auto &retired : retired_) {
+      for (auto *entry : retired.entries) {
+        release(entry);
+      }
+    }
+  }
+
+  void set(std::string key, std::string value, uint32_t ttl = 0) {
+    set(std::move(key), std::move(value), std::chrono::seconds(ttl));
+  }
+
+  // TTL с точностью до Clock::duration. Нулевой TTL - запись без истечения.
+  template <typename Rep, typename Period>
+  void set(std::string key, std::string value,
+           std::chrono::duration<Rep, Period> ttl) {
+    auto expiry = clock_.expiryAfter(ttl);
+    auto hash = kv_common::hashOf(key);
+    std::lock_guard l(writer_mutex_);
+    auto *entry = allocate(key, value, expiry);
+    if (auto *old = replace(hash, entry)) {
+      if (old->expiry != kNoExpiry) {
+        expiry_queue_.erase({old->expiry, std::string(old->key())});
+      }
+      retire(old);
+    } else {
+      while (!insert(*table_.load(std::memory_order_relaxed), hash, entry)) {
+        grow();
+      }
+      ++size_;
+    }
+    if (expiry != kNoExpiry) {
+      expiry_queue_.insert({expiry, std::move(key)});
+    }
+  }
+
+  bool remove(std::string_view key) {
+    std::lock_guard l(writer_mutex_);
+    auto *entry = erase(kv_common::hashOf(key), key);
+    if (!entry) {
+      return false;
+    }
+    if (entry->expiry != kNoExpiry) {
+      expiry_queue_.erase({entry->expiry, std::string(key)});
+    }
+    retire(entry);
+    return true;
+  }
+
+  std::optional<std::string> get(std::string_view key) const {
+    ReadGuard guard(*this);
+    auto *entry = find(kv_common::hashOf(key), key);
+    if (!entry || entry->expiry <= clock_.nowTick()) {
+      return std::nullopt;
+    }
+    return std::string(entry->value());
+  }
+
+  // Медленный путь: O(n log n), на время обхода останавливает писателя.
+  std::vector<std::pair<std::string, std::string>>
+  getManySorted(std::string_view key, uint32_t count) const {
+    std::vector<std::pair<std::string, std::string>> result;
+    std::lock_guard l(writer_mutex_);
+    auto now = clock_.nowTick();
+    auto &table = *table_.load(std::memory_order_relaxed);
+    for (size_t b = 0; b <= table.mask; ++b) {
+      for (auto &slot : table.buckets[b].slots) {
+        auto *entry = slot.load(std::memory_order_relaxed);
+        if (entry && entry->key() > key && entry->expiry > now) {
+          result.emplace_back(entry->key(), entry->value());
+        }
+      }
+    }
+    auto middle = begin(result) + std::min<size_t>(count, result.size());
+    std::partial_sort(begin(result), middle, end(result));
+    result.erase(middle, end(result));
+    return result;
+  }
+
+  std::optional<std::pair<std::string, std::string>> removeOneExpiredEntry() {
+    std::lock_guard l(writer_mutex_);
+    if (expiry_queue_.empty() ||
+        begin(expiry_queue_)->expiry > clock_.nowTick()) {
+      return std::nullopt;
+    }
+    auto key = begin(expiry_queue_)->key;
+    expiry_queue_.erase(begin(expiry_queue_));
+    auto *entry = erase(kv_common::hashOf(key), key);
+    std::pair<std::string, std::string> result(std::move(key),
+                                               entry->value());
+    retire(entry);
+    return result;
+  }
+
+  size_t size() const {
+    std::lock_guard l(writer_mutex_);
+    return size_;
+  }
+
+  size_t bucketCount() const {
+    return table_.load(std::memory_order_acquire)->mask + 1;
+  }
+
+  // Доля занятых слотов.
+  double loadFactor() const {
+    std::lock_guard l(writer_mutex_);
+    return static_cast<double>(size_) /
+           static_cast<double>(
+               (table_.load(std::memory_order_relaxed)->mask + 1) *
+               kSlotsPerBucket);
+  }
+
+private:
+  // Глубина поиска пути вытеснения, как в libcuckoo: 4^5 бакетов.
+  static constexpr size_t kMaxBfsDepth = 5;
+  static constexpr size_t kVersionStripes = 4096;
+  static constexpr uint32_t kOnes = 0x01010101;
+  static constexpr uint32_t kHighs = 0x80808080;
+  // Блоки арены; записи больше kMaxPooled байт берутся из кучи.
+  static constexpr size_t kArenaBlock = size_t{1} << 20;
+  static constexpr size_t kMaxPooled = 512;
+  static constexpr size_t kReaderShards = 16;
+  // Снятых записей в эпохе, после которых писатель пробует сменить её.
+  static constexpr size_t kReclaimBatch = 64;
+
+  // Заголовок записи, за ним key_size байт ключа и value_size байт
+  // значения. После публикации не меняется до освобождения.
+  struct Entry {
+    uint64_t expiry;
+    uint32_t key_size;
+    uint32_t value_size;
+
+    const char *data() const {
+      return reinterpret_cast<const char *>(this + 1);
+    }
+    std::string_view key() const { return {data(), key_size}; }
+    std::string_view value() const { return {data() + key_size, value_size}; }
+  };
+
+  struct FreeEntry {
+    FreeEntry *next;
+  };
+
+  struct Bucket {
+    // Метка слота i в байте i; 0 - слот пуст.
+    std::atomic<uint32_t> tags{0};
+    std::atomic<const Entry *> slots[kSlotsPerBucket]{};
+  };
+
+  struct Table {
+    explicit Table(size_t bucket_count)
+        : mask(bucket_count - 1),
+          buckets(std::make_unique<Bucket[]>(bucket_count)) {}
+
+    size_t mask;
+    std::unique_ptr<Bucket[]> buckets;
+  };
+
+  // Читатели эпохи с чётностью i в active[i]. Шарды - чтобы потоки не
+  // делили одну кэш-линию; поток получает шард по кругу при первом get.
+  struct alignas(64) ReaderShard {
+    std::atomic<uint32_t> active[2]{};
+  };
+
+  // Снятое писателем в одну эпоху.
+  struct Retired {
+    std::vector<const Entry *> entries;
+    std::vector<std::unique_ptr<Table>> tables;
+  };
+
+  // Вход в эпоху: счётчик текущей эпохи увеличивается, и если за это
+  // время писатель её сменил, попытка повторяется. Пока счётчик не
+  // сброшен, писатель не освобождает ничего, снятого в этой эпохе или
+  // позже.
+  class ReadGuard {
+  public:
+    explicit ReadGuard(const KVCuckooStorage &storage) {
+      auto &shard = storage.readers_[readerShard()];
+      for (;;) {
+        auto &current = storage.reclaim_epoch_;
+        auto epoch = current.load(std::memory_order_seq_cst);
+        active_ = &shard.active[epoch & 1];
+        active_->fetch_add(1, std::memory_order_seq_cst);
+        if (current.load(std::memory_order_seq_cst) == epoch) {
+          return;
+        }
+        active_->fetch_sub(1, std::memory_order_release);
+      }
+    }
+    ReadGuard(const ReadGuard &) = delete;
+    ReadGuard &operator=(const ReadGuard &) = delete;
+    ~ReadGuard() { active_->fetch_sub(1, std::memory_order_release); }
+
+  private:
+    std::atomic<uint32_t> *active_;
+  };
+
+  static uint8_t tagOf(uint64_t hash) {
+    auto tag = static_cast<uint8_t>(hash >> 56);
+    return tag != 0 ? tag : 1;
+  }
+
+  // Альтернативный бакет зависит только от текущего и метки, и
+  // alternate(alternate(b)) == b.
+  static size_t alternate(const Table &table, size_t bucket, uint8_t tag) {
+    return (bucket ^ (tag * 0x5bd1e995u)) & table.mask;
+  }
+
+  // Битовая маска байт слова tags, равных tag: в каждом совпавшем байте
+  // установлен старший бит. Ложные срабатывания возможны только в байтах
+  // выше настоящего совпадения и отсеиваются сравнением ключа.
+  static uint32_t matchTag(uint32_t tags, uint8_t tag) {
+    uint32_t x = tags ^ (kOnes * tag);
+    return (x - kOnes) & ~x & kHighs;
+  }
+
+  static size_t slotOf(uint32_t match) {
+    return static_cast<size_t>(std::countr_zero(match)) / 8;
+  }
+
+  static uint8_t tagAt(uint32_t tags, size_t slot) {
+    return static_cast<uint8_t>(tags >> (slot * 8));
+  }
+
+  std::atomic<uint32_t> &version(size_t bucket) const {
+    return versions_[bucket & (kVersionStripes - 1)];
+  }
+
+  static size_t readerShard() {
+    static std::atomic<size_t> next{0};
+    thread_local size_t shard =
+        next.fetch_add(1, std::memory_order_relaxed) % kReaderShards;
+    return shard;
+  }
+
+  static size_t entryBytes(size_t key_size, size_t value_size) {
+    return (sizeof(Entry) + key_size + value_size + alignof(Entry) - 1) /
+           alignof(Entry) * alignof(Entry);
+  }
+
+  // Память под запись: свободный кусок того же размера, хвост текущего
+  // блока арены или, для больших записей, куча.
+  void *allocateBytes(size_t bytes) {
+    if (bytes > kMaxPooled) {
+      return ::operator new(bytes);
+    }
+    auto &free = free_[bytes / alignof(Entry)];
+    if (free) {
+      auto *p = free;
+      free = free->next;
+      return p;
+    }
+    if (blocks_.empty() || block_used_ + bytes > kArenaBlock) {
+      blocks_.push_back(std::make_unique<char[]>(kArenaBlock));
+      block_used_ = 0;
+    }
+    auto *p = blocks_.back().get() + block_used_;
+    block_used_ += bytes;
+    return p;
+  }
+
+  const Entry *allocate(std::string_view key, std::string_view value,
+                        uint64_t expiry) {
+    auto *p = allocateBytes(entryBytes(key.size(), value.size()));
+    auto *entry = new (p) Entry{expiry, static_cast<uint32_t>(key.size()),
+                                static_cast<uint32_t>(value.size())};
+    auto *data = reinterpret_cast<char *>(entry + 1);
+    std::memcpy(data, key.data(), key.size());
+    std::memcpy(data + key.size(), value.data(), value.size());
+    return entry;
+  }
+
+  void release(const Entry *entry) {
+    auto bytes = entryBytes(entry->key_size, entry->value_size);
+    auto *p = const_cast<Entry *>(entry);
+    if (bytes > kMaxPooled) {
+      ::operator delete(p, bytes);
+      return;
+    }
+    auto &free = free_[bytes / alignof(Entry)];
+    free = new (p) FreeEntry{free};
+  }
+
+  Retired &retiring() {
+    return retired_[reclaim_epoch_.load(std::memory_order_relaxed) & 1];
+  }
+
+  // Запись снята из таблицы, но её ещё могут читать.
+  void retire(const Entry *entry) {
+    auto &retired = retiring();
+    retired.entries.push_back(entry);
+    if (retired.entries.size() >= kReclaimBatch) {
+      reclaim();
+    }
+  }
+
+  // Сменяет эпоху e на e + 1, если ушли читатели эпохи e - 1, и
+  // освобождает снятое в e - 1: читатели, вошедшие в e и позже, его уже
+  // не видят. Снятое в e ждёт следующей смены.
+  void reclaim() {
+    auto epoch = reclaim_epoch_.load(std::memory_order_relaxed);
+    auto previous = (epoch + 1) & 1;
+    for (auto &shard : readers_) {
+      if (shard.active[previous].load(std::memory_order_seq_cst) != 0) {
+        return;
+      }
+    }
+    auto &retired = retired_[previous];
+    for (auto *entry : retired.entries) {
+      release(entry);
+    }
+    retired.entries.clear();
+    retired.tables.clear();
+    reclaim_epoch_.store(epoch + 1, std::memory_order_seq_cst);
+  }
+
+  const Entry *findIn(const Table &table, size_t bucket, uint8_t tag,
+                      std::string_view key, size_t *slot = nullptr) const {
+    auto &b = table.buckets[bucket];
+    for (auto match = matchTag(b.tags.load(std::memory_order_acquire), tag);
+         match != 0; match &= match - 1) {
+      auto i = slotOf(match);
+      auto *entry = b.slots[i].load(std::memory_order_acquire);
+      if (entry && entry->key() == key) {
+        if (slot) {
+          *slot = i;
+        }
+        return entry;
+      }
+    }
+    return nullptr;
+  }
+
+  // Оптимистичное чтение: версии обоих бакетов чётны и не изменились за
+  // время поиска, таблица не заменена. Вызывается под ReadGuard.
+  const Entry *find(uint64_t hash, std::string_view key) const {
+    auto tag = tagOf(hash);
+    for (;;) {
+      auto *table = table_.load(std::memory_order_acquire);
+      size_t b1 = hash & table->mask;
+      size_t b2 = alternate(*table, b1, tag);
+      auto v1 = version(b1).load(std::memory_order_acquire);
+      auto v2 = version(b2).load(std::memory_order_acquire);
+      if ((v1 | v2) & 1) {
+        std::this_thread::yield();
+        continue;
+      }
+      auto *entry = findIn(*table, b1, tag, key);
+      if (!entry) {
+        entry = findIn(*table, b2, tag, key);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (version(b1).load(std::memory_order_relaxed) == v1 &&
+          version(b2).load(std::memory_order_relaxed) == v2 &&
+          table_.load(std::memory_order_relaxed) == table) {
+        return entry;
+      }
+    }
+  }
+
+  // Изменение бакетов под версиями: нечётная версия - бакет меняется.
+  // Бакеты могут делить полосу версий, тогда она сдвигается один раз.
+  void beginWrite(size_t b1, size_t b2) {
+    version(b1).fetch_add(1, std::memory_order_relaxed);
+    if (&version(b1) != &version(b2)) {
+      version(b2).fetch_add(1, std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  void endWrite(size_t b1, size_t b2) {
+    version(b1).fetch_add(1, std::memory_order_release);
+    if (&version(b1) != &version(b2)) {
+      version(b2).fetch_add(1, std::memory_order_release);
+    }
+  }
+
+  void putSlot(Table &table, size_t bucket, size_t slot, uint8_t tag,
+               const Entry *entry) {
+    auto &b = table.buckets[bucket];
+    b.slots[slot].store(entry, std::memory_order_release);
+    auto tags = b.tags.load(std::memory_order_relaxed);
+    tags = (tags & ~(0xffu << (slot * 8))) | (uint32_t{tag} << (slot * 8));
+    b.tags.store(tags, std::memory_order_release);
+  }
+
+  const Entry *clearSlot(Table &table, size_t bucket, size_t slot) {
+    auto &b = table.buckets[bucket];
+    auto tags = b.tags.load(std::memory_order_relaxed);
+    b.tags.store(tags & ~(0xffu << (slot * 8)), std::memory_order_release);
+    return b.slots[slot].exchange(nullptr, std::memory_order_acq_rel);
+  }
+
+  // Заменяет существующую запись с тем же ключом. Возвращает старую.
+  const Entry *replace(uint64_t hash, const Entry *entry) {
+    auto &table = *table_.load(std::memory_order_relaxed);
+    auto tag = tagOf(hash);
+    size_t b1 = hash & table.mask;
+    for (auto bucket : {b1, alternate(table, b1, tag)}) {
+      size_t slot;
+      if (auto *old = findIn(table, bucket, tag, entry->key(), &slot)) {
+        // Замена указателя атомарна, версии трогать не нужно.
+        table.buckets[bucket].slots[slot].store(entry,
+                                                std::memory_order_release);
+        return old;
+      }
+    }
+    return nullptr;
+  }
+
+  const Entry *erase(uint64_t hash, std::string_view key) {
+    auto &table = *table_.load(std::memory_order_relaxed);
+    auto tag = tagOf(hash);
+    size_t b1 = hash & table.mask;
+    for (auto bucket : {b1, alternate(table, b1, tag)}) {
+      size_t slot;
+      if (findIn(table, bucket, tag, key, &slot)) {
+        beginWrite(bucket, bucket);
+        auto *entry = clearSlot(table, bucket, slot);
+        endWrite(bucket, bucket);
+        --size_;
+        return entry;
+      }
+    }
+    return nullptr;
+  }
+
+  static std::optional<size_t> freeSlot(const Table &table, size_t bucket) {
+    auto match = matchTag(
+        table.buckets[bucket].tags.load(std::memory_order_relaxed), 0);
+    if (match == 0) {
+      return std::nullopt;
+    }
+    return slotOf(match);
+  }
+
+  // Вставляет запись, которой нет в таблице. false - пути вытеснения
+  // не нашлось, таблицу нужно увеличить.
+  bool insert(Table &table, uint64_t hash, const Entry *entry) {
+    auto tag = tagOf(hash);
+    size_t b1 = hash & table.mask;
+    size_t b2 = alternate(table, b1, tag);
+    for (auto bucket : {b1, b2}) {
+      if (auto slot = freeSlot(table, bucket)) {
+        beginWrite(bucket, bucket);
+        putSlot(table, bucket, *slot, tag, entry);
+        endWrite(bucket, bucket);
+        return true;
+      }
+    }
+    auto path = findPath(table, b1, b2);
+    if (path.empty()) {
+      return false;
+    }
+    // Сдвиги с конца пути: каждый освобождает слот для предыдущего, и
+    // запись всё время видна хотя бы в одном из своих бакетов.
+    for (size_t i = path.size() - 1; i-- > 0;) {
+      auto [from, from_slot] = path[i];
+      auto [to, to_slot] = path[i + 1];
+      auto moved_tag = tagAt(
+          table.buckets[from].tags.load(std::memory_order_relaxed), from_slot);
+      beginWrite(from, to);
+      auto *moved = table.buckets[from].slots[from_slot].load(
+          std::memory_order_relaxed);
+      putSlot(table, to, to_slot, moved_tag, moved);
+      clearSlot(table, from, from_slot);
+      endWrite(from, to);
+    }
+    auto [bucket, slot] = path.front();
+    beginWrite(bucket, bucket);
+    putSlot(table, bucket, slot, tag, entry);
+    endWrite(bucket, bucket);
+    return true;
+  }
+
+  // Поиск в ширину от бакетов b1 и b2 до бакета со свободным слотом.
+  // Возвращает цепочку (бакет, слот): запись из каждого звена переезжает
+  // в следующее, последнее звено свободно. Пусто, если пути нет.
+  std::vector<std::pair<size_t, size_t>> findPath(const Table &table,
+                                                  size_t b1, size_t b2) const {
+    struct Node {
+      size_t bucket;
+      size_t parent; // индекс в nodes, npos у корней
+      size_t slot;   // слот родителя, ведущий сюда
+      size_t depth;
+    };
+    constexpr size_t npos = std::numeric_limits<size_t>::max();
+    std::vector<Node> nodes{{b1, npos, 0, 0}, {b2, npos, 0, 0}};
+    for (size_t n = 0; n < nodes.size(); ++n) {
+      auto node = nodes[n];
+      if (auto slot = freeSlot(table, node.bucket)) {
+        std::vector<std::pair<size_t, size_t>> path{{node.bucket, *slot}};
+        for (auto i = n; nodes[i].parent != npos; i = nodes[i].parent) {
+          path.emplace_back(nodes[nodes[i].parent].bucket, nodes[i].slot);
+        }
+        std::reverse(begin(path), end(path));
+        return path;
+      }
+      if (node.depth == kMaxBfsDepth) {
+        continue;
+      }
+      auto tags = table.buckets[node.bucket].tags.load(
+          std::memory_order_relaxed);
+      for (size_t slot = 0; slot < kSlotsPerBucket; ++slot) {
+        auto next = alternate(table, node.bucket, tagAt(tags, slot));
+        // Бакет не должен повторяться в пути, иначе сдвиги затрут друг
+        // друга; проверка по предкам дешевле общего множества.
+        bool cycle = false;
+        for (auto i = n; i != npos; i = nodes[i].parent) {
+          cycle |= nodes[i].bucket == next;
+        }
+        if (!cycle) {
+          nodes.push_back({next, n, slot, node.depth + 1});
+        }
+      }
+    }
+    return {};
+  }
+
+  // Переносит записи в таблицу вдвое больше. Читатели старой таблицы
+  // заметят замену по table_ и повторят поиск; сама она освобождается по
+  // эпохам, как снятые записи. Записи переезжают указателями.
+  void grow() {
+    auto &old = *table_.load(std::memory_order_relaxed);
+    for (size_t buckets = (old.mask + 1) * 2;; buckets *= 2) {
+      auto table = std::make_unique<Table>(buckets);
+      bool complete = true;
+      for (size_t b = 0; b <= old.mask && complete; ++b) {
+        for (auto &slot : old.buckets[b].slots) {
+          auto *entry = slot.load(std::memory_order_relaxed);
+          if (entry &&
+              !insert(*table, kv_common::hashOf(entry->key()), entry)) {
+            complete = false;
+            break;
+          }
+        }
+      }
+      if (complete) {
+        table_.store(table.get(), std::memory_order_release);
+        retiring().tables.push_back(std::exchange(current_, std::move(table)));
+        // Две смены: старая таблица снята в текущей эпохе, и без
+        // читателей её можно отдать сразу, а не при следующем росте.
+        reclaim();
+        reclaim();
+        break;
+      }
+    }
+  }
+
+  kv_common::TickClock<Clock> clock_;
+  mutable std::mutex writer_mutex_;
+  std::atomic<Table *> table_{nullptr};
+  std::unique_ptr<Table> current_;
+  mutable std::unique_ptr<std::atomic<uint32_t>[]> versions_ =
+      std::make_unique<std::atomic<uint32_t>[]>(kVersionStripes);
+  size_t size_ = 0;
+  std::set<kv_common::ExpiryEntry> expiry_queue_;
+  // Арена записей: блоки и списки свободных кусков по размеру с шагом
+  // alignof(Entry).
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  size_t block_used_ = 0;
+  std::array<FreeEntry *, kMaxPooled / alignof(Entry) + 1> free_{};
+  std::atomic<uint64_t> reclaim_epoch_{0};
+  mutable std::array<ReaderShard, kReaderShards> readers_;
+  // Снятое в эпохе e - в retired_[e & 1].
+  std::array<Retired, 2> retired_;
+};
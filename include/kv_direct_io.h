@@ -0,0 +1,367 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Ввод-вывод файлов WAL и снапшотов в обход page cache (O_DIRECT).
+// Там, где O_DIRECT не поддерживается (tmpfs, часть FUSE), используется
+// обычный буферизованный ввод-вывод.
+namespace kv_io {
+
+inline constexpr size_t kDirectIoAlignment = 4096;
+
+// Пул выровненных буферов фиксированного размера. Буферы возвращаются
+// в пул, а не освобождаются, чтобы не платить за aligned_alloc на каждом
+// сбросе.
+class AlignedBufferPool {
+public:
+  struct Deleter {
+    AlignedBufferPool *pool;
+    void operator()(char *data) const { pool->release(data); }
+  };
+  using Buffer = std::unique_ptr<char[], Deleter>;
+
+  explicit AlignedBufferPool(size_t buffer_size = 1 << 20,
+                             size_t alignment = kDirectIoAlignment)
+      : buffer_size_((buffer_size + alignment - 1) / alignment * alignment),
+        alignment_(alignment) {}
+
+  AlignedBufferPool(const AlignedBufferPool &) = delete;
+  AlignedBufferPool &operator=(const AlignedBufferPool &) = delete;
+
+  ~AlignedBufferPool() {
+    for (char *data : free_) {
+      std::free(data);
+    }
+  }
+
+  Buffer acquire() {
+    {
+      std::lock_guard l(mutex_);
+      if (!free_.empty()) {
+        char *data = free_.back();
+        free_.pop_back();
+        return Buffer(data, Deleter{this});
+      }
+    }
+    auto data = static_cast<char *>(std::aligned_alloc(alignment_, buffer_size_));
+    if (!data) {
+      throw std::bad_alloc();
+    }
+    return Buffer(data, Deleter{this});
+  }
+
+  size_t bufferSize() const { return buffer_size_; }
+  size_t alignment() const { return alignment_; }
+
+  size_t freeBuffers() const {
+    std::lock_guard l(mutex_);
+    return free_.size();
+  }
+
+private:
+  void release(char *data) {
+    std::lock_guard l(mutex_);
+    free_.push_back(data);
+  }
+
+  size_t buffer_size_;
+  size_t alignment_;
+  mutable std::mutex mutex_;
+  std::vector<char *> free_;
+};
+
+enum class IoMode {
+  Direct,   // O_DIRECT, при неудаче откат на буферизованный режим
+  Buffered, // всегда через page cache
+};
+
+// Последовательная запись файла выровненными буферами. Заполненные буферы
+// уходят в фоновый поток, так что append не ждёт диска, пока не занято
+// больше max_in_flight буферов.
+class DirectFileWriter {
+public:
+  DirectFileWriter(AlignedBufferPool &pool, size_t max_in_flight = 4)
+      : pool_(pool), max_in_flight_(max_in_flight) {}
+
+  DirectFileWriter(const DirectFileWriter &) = delete;
+  DirectFileWriter &operator=(const DirectFileWriter &) = delete;
+
+  ~DirectFileWriter() { close(); }
+
+  std::error_code open(const std::string &path, IoMode mode = IoMode::Direct) {
+    close();
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    fd_ = -1;
+#ifdef O_DIRECT
+    if (mode == IoMode::Direct) {
+      fd_ = ::open(path.c_str(), flags | O_DIRECT, 0644);
+      direct_ = fd_ >= 0;
+    }
+#endif
+    if (fd_ < 0) {
+      fd_ = ::open(path.c_str(), flags, 0644);
+      direct_ = false;
+    }
+    if (fd_ < 0) {
+      return {errno, std::generic_category()};
+    }
+    error_ = {};
+    file_offset_ = 0;
+    logical_size_ = 0;
+    stopping_ = false;
+    current_ = pool_.acquire();
+    current_size_ = 0;
+    worker_ = std::thread([this] { run(); });
+    return {};
+  }
+
+  bool isOpen() const { return fd_ >= 0; }
+  // true, если файл действительно открыт с O_DIRECT.
+  bool direct() const { return direct_; }
+  size_t size() const { return logical_size_; }
+
+  void append(std::string_view data) {
+    while (!data.empty()) {
+      size_t n = std::min(data.size(), pool_.bufferSize() - current_size_);
+      std::memcpy(current_.get() + current_size_, data.data(), n);
+      current_size_ += n;
+      logical_size_ += n;
+      data.remove_prefix(n);
+      if (current_size_ == pool_.bufferSize()) {
+        submit(std::move(current_), current_size_);
+        current_ = pool_.acquire();
+        current_size_ = 0;
+      }
+    }
+  }
+
+  // Дожидается записи всех отправленных буферов. Хвост, не кратный
+  // выравниванию, остаётся в памяти до sync() или close().
+  std::error_code flush() {
+    std::unique_lock l(mutex_);
+    drained_.wait(l, [this] { return queue_.empty() && !writing_; });
+    return error_;
+  }
+
+  // Делает долговечным всё добавленное, не закрывая файл: дожидается
+  // отправленных буферов, пишет хвост, дополненный нулями до блока,
+  // обрезает файл до логического размера и вызывает fdatasync. Смещение
+  // в файле не сдвигается, поэтому следующий сброс буфера перезапишет
+  // хвостовой блок уже с новыми данными.
+  std::error_code sync() {
+    if (fd_ < 0) {
+      return error_;
+    }
+    if (auto ec = flush()) {
+      return ec;
+    }
+    std::error_code ec;
+    if (current_size_ > 0) {
+      size_t padded = paddedTail();
+      std::memset(current_.get() + current_size_, 0, padded - current_size_);
+      ec = writeAll(current_.get(), padded, file_offset_);
+    }
+    if (!ec && ::ftruncate(fd_, static_cast<off_t>(logical_size_)) != 0) {
+      ec = {errno, std::generic_category()};
+    }
+    if (!ec && ::fdatasync(fd_) != 0) {
+      ec = {errno, std::generic_category()};
+    }
+    std::lock_guard l(mutex_);
+    if (ec && !error_) {
+      error_ = ec;
+    }
+    return error_;
+  }
+
+  // Дописывает хвост с выравниванием нулями, обрезает файл до логического
+  // размера и при sync == true вызывает fdatasync.
+  std::error_code close(bool sync = false) {
+    if (fd_ < 0) {
+      return error_;
+    }
+    if (current_size_ > 0) {
+      size_t padded = paddedTail();
+      std::memset(current_.get() + current_size_, 0, padded - current_size_);
+      submit(std::move(current_), padded);
+    }
+    current_.reset();
+    current_size_ = 0;
+    {
+      std::unique_lock l(mutex_);
+      stopping_ = true;
+    }
+    ready_.notify_one();
+    worker_.join();
+
+    std::lock_guard l(mutex_);
+    if (!error_ && ::ftruncate(fd_, static_cast<off_t>(logical_size_)) != 0) {
+      error_ = {errno, std::generic_category()};
+    }
+    if (!error_ && sync && ::fdatasync(fd_) != 0) {
+      error_ = {errno, std::generic_category()};
+    }
+    ::close(fd_);
+    fd_ = -1;
+    return error_;
+  }
+
+private:
+  struct Pending {
+    AlignedBufferPool::Buffer buffer;
+    size_t size;
+    off_t offset;
+  };
+
+  size_t paddedTail() const {
+    return (current_size_ + pool_.alignment() - 1) / pool_.alignment() *
+           pool_.alignment();
+  }
+
+  void submit(AlignedBufferPool::Buffer buffer, size_t size) {
+    std::unique_lock l(mutex_);
+    drained_.wait(l, [this] { return queue_.size() < max_in_flight_; });
+    queue_.push_back({std::move(buffer), size, file_offset_});
+    file_offset_ += static_cast<off_t>(size);
+    ready_.notify_one();
+  }
+
+  void run() {
+    std::unique_lock l(mutex_);
+    while (true) {
+      ready_.wait(l, [this] { return stopping_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        return;
+      }
+      Pending pending = std::move(queue_.front());
+      queue_.pop_front();
+      writing_ = true;
+      l.unlock();
+      auto ec = writeAll(pending.buffer.get(), pending.size, pending.offset);
+      pending.buffer.reset();
+      l.lock();
+      writing_ = false;
+      if (ec && !error_) {
+        error_ = ec;
+      }
+      drained_.notify_all();
+    }
+  }
+
+  std::error_code writeAll(const char *data, size_t size, off_t offset) {
+    size_t done = 0;
+    while (done < size) {
+      ssize_t n = ::pwrite(fd_, data + done, size - done,
+                           offset + static_cast<off_t>(done));
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+#ifdef O_DIRECT
+      // Некоторые ФС принимают O_DIRECT в open, но отвергают запись.
+      if (n < 0 && errno == EINVAL && direct_) {
+        int flags = ::fcntl(fd_, F_GETFL);
+        if (flags >= 0 && ::fcntl(fd_, F_SETFL, flags & ~O_DIRECT) == 0) {
+          direct_ = false;
+          continue;
+        }
+      }
+#endif
+      if (n < 0) {
+        return {errno, std::generic_category()};
+      }
+      done += static_cast<size_t>(n);
+    }
+    return {};
+  }
+
+  AlignedBufferPool &pool_;
+  size_t max_in_flight_;
+  int fd_ = -1;
+  std::atomic<bool> direct_ = false;
+  AlignedBufferPool::Buffer current_{nullptr, {nullptr}};
+  size_t current_size_ = 0;
+  size_t logical_size_ = 0;
+  off_t file_offset_ = 0;
+
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::condition_variable drained_;
+  std::deque<Pending> queue_;
+  bool writing_ = false;
+  bool stopping_ = false;
+  std::error_code error_;
+  std::thread worker_;
+};
+
+// Читает файл целиком через выровненные буферы пула.
+inline std::error_code readFile(const std::string &path, std::string &out,
+                                AlignedBufferPool &pool,
+                                IoMode mode = IoMode::Direct) {
+  int fd = -1;
+#ifdef O_DIRECT
+  if (mode == IoMode::Direct) {
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+  }
+#endif
+  if (fd < 0) {
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  }
+  if (fd < 0) {
+    return {errno, std::generic_category()};
+  }
+
+  out.clear();
+  struct stat st;
+  if (::fstat(fd, &st) == 0) {
+    out.reserve(static_cast<size_t>(st.st_size));
+  }
+  auto buffer = pool.acquire();
+  off_t offset = 0;
+  while (true) {
+    ssize_t n = ::pread(fd, buffer.get(), pool.bufferSize(), offset);
+#ifdef O_DIRECT
+    if (n < 0 && errno == EINVAL) {
+      int flags = ::fcntl(fd, F_GETFL);
+      if (flags >= 0 && (flags & O_DIRECT) &&
+          ::fcntl(fd, F_SETFL, flags & ~O_DIRECT) == 0) {
+        continue;
+      }
+    }
+#endif
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      std::error_code ec(errno, std::generic_category());
+      ::close(fd);
+      return ec;
+    }
+    if (n == 0) {
+      break;
+    }
+    out.append(buffer.get(), static_cast<size_t>(n));
+    offset += n;
+  }
+  ::close(fd);
+  return {};
+}
+
+} // namespace kv_io
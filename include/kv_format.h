@@ -0,0 +1,364 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) &&                              \
+    (defined(__GNUC__) || defined(__clang__))
+#define KV_FORMAT_HAS_SSE42 1
+#include <nmmintrin.h>
+#endif
+
+// Версионированный бинарный формат записей KVStorage.
+//
+// Файл: FileHeader, затем последовательность блоков.
+// Блок: BlockHeader (32 байта) + payload из record_count записей.
+// Запись: fixed64 seq, fixed64 expiry, varint key_size, varint value_size,
+// байты ключа, байты значения. Все числа little-endian.
+// CRC32C считается отдельно для заголовка блока и для payload.
+namespace kv_format {
+
+inline constexpr uint32_t kFileMagic = 0x3153564B;  // "KVS1"
+inline constexpr uint32_t kBlockMagic = 0x3142564B; // "KVB1"
+inline constexpr uint16_t kFormatVersion = 1;
+inline constexpr size_t kFileHeaderSize = 16;
+inline constexpr size_t kBlockHeaderSize = 32;
+// expiry == kNoExpiry означает запись без TTL, иначе это абсолютное время
+// истечения в миллисекундах от эпохи часов.
+inline constexpr int64_t kNoExpiry = 0;
+
+enum class Status {
+  Ok,
+  EndOfData,
+  Truncated,
+  BadMagic,
+  UnsupportedVersion,
+  HeaderChecksumMismatch,
+  PayloadChecksumMismatch,
+  Corrupt,
+};
+
+inline const char *toString(Status status) {
+  switch (status) {
+  case Status::Ok:
+    return "ok";
+  case Status::EndOfData:
+    return "end of data";
+  case Status::Truncated:
+    return "truncated";
+  case Status::BadMagic:
+    return "bad magic";
+  case Status::UnsupportedVersion:
+    return "unsupported version";
+  case Status::HeaderChecksumMismatch:
+    return "header checksum mismatch";
+  case Status::PayloadChecksumMismatch:
+    return "payload checksum mismatch";
+  case Status::Corrupt:
+    return "corrupt";
+  }
+  return "unknown";
+}
+
+struct RecordView {
+  std::string_view key;
+  std::string_view value;
+  int64_t expiry;
+  uint64_t seq;
+};
+
+namespace detail {
+
+inline constexpr uint32_t kCrc32cPoly = 0x82F63B78;
+
+inline constexpr auto kCrc32cTables = [] {
+  std::array<std::array<uint32_t, 256>, 8> tables{};
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t crc = i;
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc >> 1) ^ ((crc & 1) ? kCrc32cPoly : 0);
+    }
+    tables[0][i] = crc;
+  }
+  for (uint32_t i = 0; i < 256; ++i) {
+    for (size_t t = 1; t < 8; ++t) {
+      uint32_t prev = tables[t - 1][i];
+      tables[t][i] = (prev >> 8) ^ tables[0][prev & 0xFF];
+    }
+  }
+  return tables;
+}();
+
+inline uint64_t loadLE64(const unsigned char *p) {
+  uint64_t v = 0;
+  for (int i = 7; i >= 0; --i) {
+    v = (v << 8) | p[i];
+  }
+  return v;
+}
+
+inline uint32_t loadLE32(const unsigned char *p) {
+  return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 |
+         uint32_t(p[3]) << 24;
+}
+
+inline uint32_t crc32cSoftware(uint32_t crc, const unsigned char *p,
+                               size_t n) {
+  const auto &t = kCrc32cTables;
+  while (n >= 8) {
+    uint64_t v = loadLE64(p) ^ crc;
+    crc = t[7][v & 0xFF] ^ t[6][(v >> 8) & 0xFF] ^ t[5][(v >> 16) & 0xFF] ^
+          t[4][(v >> 24) & 0xFF] ^ t[3][(v >> 32) & 0xFF] ^
+          t[2][(v >> 40) & 0xFF] ^ t[1][(v >> 48) & 0xFF] ^ t[0][v >> 56];
+    p += 8;
+    n -= 8;
+  }
+  while (n--) {
+    crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+  }
+  return crc;
+}
+
+#ifdef KV_FORMAT_HAS_SSE42
+__attribute__((target("sse4.2"))) inline uint32_t
+crc32cSse42(uint32_t crc, const unsigned char *p, size_t n) {
+#if defined(__x86_64__)
+  uint64_t crc64 = crc;
+  while (n >= 8) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    crc64 = _mm_crc32_u64(crc64, v);
+    p += 8;
+    n -= 8;
+  }
+  crc = static_cast<uint32_t>(crc64);
+#endif
+  while (n >= 4) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    crc = _mm_crc32_u32(crc, v);
+    p += 4;
+    n -= 4;
+  }
+  while (n--) {
+    crc = _mm_crc32_u8(crc, *p++);
+  }
+  return crc;
+}
+#endif
+
+inline void putFixed32(std::string &out, uint32_t v) {
+  char buf[4];
+  for (int i = 0; i < 4; ++i) {
+    buf[i] = static_cast<char>(v >> (8 * i));
+  }
+  out.append(buf, sizeof(buf));
+}
+
+inline void putFixed64(std::string &out, uint64_t v) {
+  char buf[8];
+  for (int i = 0; i < 8; ++i) {
+    buf[i] = static_cast<char>(v >> (8 * i));
+  }
+  out.append(buf, sizeof(buf));
+}
+
+inline void putVarint(std::string &out, uint64_t v) {
+  while (v >= 0x80) {
+    out.push_back(static_cast<char>(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back(static_cast<char>(v));
+}
+
+inline bool getVarint(const unsigned char *&p, const unsigned char *end,
+                      uint64_t &v) {
+  v = 0;
+  for (int shift = 0; shift < 64 && p < end; shift += 7) {
+    uint64_t byte = *p++;
+    v |= (byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+inline void storeLE32(char *p, uint32_t v) {
+  for (int i = 0; i < 4; ++i) {
+    p[i] = static_cast<char>(v >> (8 * i));
+  }
+}
+
+} // namespace detail
+
+inline bool crc32cHardwareAvailable() {
+#ifdef KV_FORMAT_HAS_SSE42
+  static const bool available = __builtin_cpu_supports("sse4.2");
+  return available;
+#else
+  return false;
+#endif
+}
+
+// Продолжает CRC32C (Castagnoli) значения crc на n байтах data.
+inline uint32_t crc32c(const void *data, size_t n, uint32_t crc = 0) {
+  auto p = static_cast<const unsigned char *>(data);
+  crc = ~crc;
+#ifdef KV_FORMAT_HAS_SSE42
+  if (crc32cHardwareAvailable()) {
+    return ~detail::crc32cSse42(crc, p, n);
+  }
+#endif
+  return ~detail::crc32cSoftware(crc, p, n);
+}
+
+inline uint32_t crc32cSoftware(const void *data, size_t n, uint32_t crc = 0) {
+  return ~detail::crc32cSoftware(
+      ~crc, static_cast<const unsigned char *>(data), n);
+}
+
+inline uint32_t crc32c(std::string_view data, uint32_t crc = 0) {
+  return crc32c(data.data(), data.size(), crc);
+}
+
+inline void appendFileHeader(std::string &out) {
+  size_t start = out.size();
+  detail::putFixed32(out, kFileMagic);
+  detail::putFixed32(out, kFormatVersion);
+  detail::putFixed32(out, 0);
+  detail::putFixed32(out, crc32c(out.data() + start, 12));
+}
+
+inline Status readFileHeader(std::string_view in, size_t &offset) {
+  if (in.size() - offset < kFileHeaderSize) {
+    return Status::Truncated;
+  }
+  auto p = reinterpret_cast<const unsigned char *>(in.data() + offset);
+  if (detail::loadLE32(p) != kFileMagic) {
+    return Status::BadMagic;
+  }
+  if (detail::loadLE32(p + 12) != crc32c(p, 12)) {
+    return Status::HeaderChecksumMismatch;
+  }
+  if (detail::loadLE32(p + 4) != kFormatVersion) {
+    return Status::UnsupportedVersion;
+  }
+  offset += kFileHeaderSize;
+  return Status::Ok;
+}
+
+// Накапливает записи в payload одного блока.
+class BlockBuilder {
+public:
+  void add(std::string_view key, std::string_view value, int64_t expiry,
+           uint64_t seq) {
+    if (record_count_ == 0) {
+      first_seq_ = seq;
+    }
+    detail::putFixed64(payload_, seq);
+    detail::putFixed64(payload_, static_cast<uint64_t>(expiry));
+    detail::putVarint(payload_, key.size());
+    detail::putVarint(payload_, value.size());
+    payload_.append(key);
+    payload_.append(value);
+    ++record_count_;
+  }
+
+  bool empty() const { return record_count_ == 0; }
+  uint32_t recordCount() const { return record_count_; }
+  size_t payloadSize() const { return payload_.size(); }
+
+  // Дописывает готовый блок в out и очищает builder.
+  void finish(std::string &out) {
+    size_t start = out.size();
+    detail::putFixed32(out, kBlockMagic);
+    detail::putFixed32(out, kFormatVersion);
+    detail::putFixed32(out, static_cast<uint32_t>(payload_.size()));
+    detail::putFixed32(out, record_count_);
+    detail::putFixed64(out, first_seq_);
+    detail::putFixed32(out, crc32c(payload_));
+    detail::putFixed32(out, 0);
+    detail::storeLE32(out.data() + start + 28,
+                      crc32c(out.data() + start, 28));
+    out.append(payload_);
+    payload_.clear();
+    record_count_ = 0;
+    first_seq_ = 0;
+  }
+
+private:
+  std::string payload_;
+  uint32_t record_count_ = 0;
+  uint64_t first_seq_ = 0;
+};
+
+// Разбирает блок, начинающийся с in[offset]. При успехе добавляет записи
+// в out (string_view указывают в in) и сдвигает offset за блок.
+inline Status readBlock(std::string_view in, size_t &offset,
+                        std::vector<RecordView> &out) {
+  if (offset == in.size()) {
+    return Status::EndOfData;
+  }
+  if (in.size() - offset < kBlockHeaderSize) {
+    return Status::Truncated;
+  }
+  auto header = reinterpret_cast<const unsigned char *>(in.data() + offset);
+  if (detail::loadLE32(header) != kBlockMagic) {
+    return Status::BadMagic;
+  }
+  if (detail::loadLE32(header + 28) != crc32c(header, 28)) {
+    return Status::HeaderChecksumMismatch;
+  }
+  if (detail::loadLE32(header + 4) != kFormatVersion) {
+    return Status::UnsupportedVersion;
+  }
+  uint32_t payload_size = detail::loadLE32(header + 8);
+  uint32_t record_count = detail::loadLE32(header + 12);
+  if (in.size() - offset - kBlockHeaderSize < payload_size) {
+    return Status::Truncated;
+  }
+  auto p = header + kBlockHeaderSize;
+  auto end = p + payload_size;
+  if (detail::loadLE32(header + 24) != crc32c(p, payload_size)) {
+    return Status::PayloadChecksumMismatch;
+  }
+
+  size_t first = out.size();
+  for (uint32_t i = 0; i < record_count; ++i) {
+    uint64_t key_size = 0;
+    uint64_t value_size = 0;
+    if (end - p < 16) {
+      out.resize(first);
+      return Status::Corrupt;
+    }
+    uint64_t seq = detail::loadLE64(p);
+    auto expiry = static_cast<int64_t>(detail::loadLE64(p + 8));
+    p += 16;
+    if (!detail::getVarint(p, end, key_size) ||
+        !detail::getVarint(p, end, value_size) ||
+        static_cast<uint64_t>(end - p) < key_size ||
+        static_cast<uint64_t>(end - p) - key_size < value_size) {
+      out.resize(first);
+      return Status::Corrupt;
+    }
+    auto chars = reinterpret_cast<const char *>(p);
+    out.push_back({std::string_view(chars, key_size),
+                   std::string_view(chars + key_size, value_size), expiry,
+                   seq});
+    p += key_size + value_size;
+  }
+  if (p != end) {
+    out.resize(first);
+    return Status::Corrupt;
+  }
+  offset += kBlockHeaderSize + payload_size;
+  return Status::Ok;
+}
+
+} // namespace kv_format
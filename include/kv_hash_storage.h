@@ -0,0 +1,288 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "kv_common.h"
+
+// Неупорядоченный движок для нагрузок только из точечных операций.
+// Ключи разбиты по шардам со своей блокировкой; внутри шарда - хеш-таблица
+// с открытой адресацией и линейным пробированием. getManySorted
+// поддерживается медленным путём: обходом всех шардов и сортировкой.
+template <typename Clock = std::chrono::steady_clock,
+          typename Lock = std::shared_mutex>
+class KVHashStorage {
+public:
+  static constexpr uint64_t kNoExpiry = kv_common::kNoExpiry;
+  static constexpr size_t kDefaultShards = 64;
+
+  // shards округляется вверх до степени двойки.
+  explicit KVHashStorage(
+      std::span<std::tuple<std::string, std::string, uint32_t>> entries,
+      Clock clock = Clock{}, size_t shards = kDefaultShards)
+      : clock_(clock),
+        shards_(std::bit_ceil(std::max<size_t>(shards, 1))),
+        shard_mask_(shards_.size() - 1) {
+    for (auto &[key, value, ttl] : entries) {
+      set(key, value, ttl);
+    }
+  }
+
+  void set(std::string key, std::string value, uint32_t ttl = 0) {
+    set(std::move(key), std::move(value), std::chrono::seconds(ttl));
+  }
+
+  // TTL с точностью до Clock::duration. Нулевой TTL - запись без истечения.
+  template <typename Rep, typename Period>
+  void set(std::string key, std::string value,
+           std::chrono::duration<Rep, Period> ttl) {
+    auto expiry = clock_.expiryAfter(ttl);
+    auto hash = kv_common::hashOf(key);
+    auto &shard = shardOf(hash);
+    std::unique_lock l(shard.mutex);
+    shard.set(hash, std::move(key), std::move(value), expiry);
+  }
+
+  bool remove(std::string_view key) {
+    auto hash = kv_common::hashOf(key);
+    auto &shard = shardOf(hash);
+    std::unique_lock l(shard.mutex);
+    auto index = shard.find(hash, key);
+    if (!index) {
+      return false;
+    }
+    shard.erase(*index);
+    return true;
+  }
+
+  std::optional<std::string> get(std::string_view key) const {
+    auto hash = kv_common::hashOf(key);
+    auto &shard = shardOf(hash);
+    std::shared_lock l(shard.mutex);
+    auto index = shard.find(hash, key);
+    if (!index) {
+      return std::nullopt;
+    }
+    auto &slot = shard.slots[*index];
+    if (slot.expiry <= clock_.nowTick()) {
+      return std::nullopt;
+    }
+    return slot.value;
+  }
+
+  // Медленный путь: O(n log n), по очереди берёт shared-блокировку
+  // каждого шарда. Для упорядоченных обходов нужен KVStorage.
+  std::vector<std::pair<std::string, std::string>>
+  getManySorted(std::string_view key, uint32_t count) const {
+    std::vector<std::pair<std::string, std::string>> result;
+    auto now = clock_.nowTick();
+    for (auto &shard : shards_) {
+      std::shared_lock l(shard.mutex);
+      for (size_t i = 0; i < shard.slots.size(); ++i) {
+        auto &slot = shard.slots[i];
+        if (isFull(shard.control[i]) && slot.key > key && slot.expiry > now) {
+          result.emplace_back(slot.key, slot.value);
+        }
+      }
+    }
+    auto middle = begin(result) + std::min<size_t>(count, result.size());
+    std::partial_sort(begin(result), middle, end(result));
+    result.erase(middle, end(result));
+    return result;
+  }
+
+  // Удаляет запись с самым ранним истёкшим сроком. Шарды просматриваются
+  // под shared-блокировкой, затем выбранный берётся эксклюзивно; если
+  // запись успели удалить, поиск повторяется.
+  std::optional<std::pair<std::string, std::string>> removeOneExpiredEntry() {
+    for (;;) {
+      auto now = clock_.nowTick();
+      Shard *earliest = nullptr;
+      uint64_t earliest_expiry = kNoExpiry;
+      for (auto &shard : shards_) {
+        std::shared_lock l(shard.mutex);
+        if (!shard.expiry_queue.empty()) {
+          auto expiry = begin(shard.expiry_queue)->expiry;
+          if (expiry <= now && expiry < earliest_expiry) {
+            earliest = &shard;
+            earliest_expiry = expiry;
+          }
+        }
+      }
+      if (!earliest) {
+        return std::nullopt;
+      }
+
+      std::unique_lock l(earliest->mutex);
+      if (earliest->expiry_queue.empty() ||
+          begin(earliest->expiry_queue)->expiry > now) {
+        continue;
+      }
+      auto &key = begin(earliest->expiry_queue)->key;
+      auto index = *earliest->find(kv_common::hashOf(key), key);
+      auto &slot = earliest->slots[index];
+      auto result = std::make_pair(std::move(slot.key), std::move(slot.value));
+      earliest->erase(index, result.first);
+      return result;
+    }
+  }
+
+  size_t size() const {
+    size_t total = 0;
+    for (auto &shard : shards_) {
+      std::shared_lock l(shard.mutex);
+      total += shard.size;
+    }
+    return total;
+  }
+
+private:
+  // Управляющий байт слота: kEmpty, kDeleted или 7 старших бит хеша.
+  static constexpr uint8_t kEmpty = 0x80;
+  static constexpr uint8_t kDeleted = 0xfe;
+  static constexpr size_t kMinCapacity = 16;
+
+  static bool isFull(uint8_t control) { return (control & 0x80) == 0; }
+
+  struct Slot {
+    std::string key;
+    std::string value;
+    uint64_t expiry = kNoExpiry;
+  };
+
+  // Шард на своей кэш-линии, чтобы блокировки соседних шардов не
+  // делили её между ядрами.
+  struct alignas(64) Shard {
+    std::optional<size_t> find(uint64_t hash, std::string_view key) const {
+      if (slots.empty()) {
+        return std::nullopt;
+      }
+      size_t mask = slots.size() - 1;
+      auto tag = tagOf(hash);
+      for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        if (control[i] == kEmpty) {
+          return std::nullopt;
+        }
+        if (control[i] == tag && slots[i].key == key) {
+          return i;
+        }
+      }
+    }
+
+    void set(uint64_t hash, std::string key, std::string value,
+             uint64_t expiry) {
+      if (auto index = find(hash, key)) {
+        auto &slot = slots[*index];
+        if (slot.expiry != kNoExpiry) {
+          expiry_queue.erase({slot.expiry, slot.key});
+        }
+        slot.value = std::move(value);
+        slot.expiry = expiry;
+        if (expiry != kNoExpiry) {
+          expiry_queue.insert({expiry, slot.key});
+        }
+        return;
+      }
+      // Таблица заполнена не больше чем на 7/8 вместе с удалёнными.
+      if ((size + deleted + 1) * 8 > slots.size() * 7) {
+        // Если место заняли в основном метки удаления, хватит очистки.
+        rehash(size * 4 >= slots.size() ? slots.size() * 2 : slots.size());
+      }
+      size_t mask = slots.size() - 1;
+      size_t i = hash & mask;
+      while (isFull(control[i])) {
+        i = (i + 1) & mask;
+      }
+      if (control[i] == kDeleted) {
+        --deleted;
+      }
+      control[i] = tagOf(hash);
+      slots[i] = {std::move(key), std::move(value), expiry};
+      ++size;
+      if (expiry != kNoExpiry) {
+        expiry_queue.insert({expiry, slots[i].key});
+      }
+    }
+
+    void erase(size_t index) {
+      auto &slot = slots[index];
+      erase(index, slot.key);
+    }
+
+    // key - ключ записи; его можно заранее переместить из слота.
+    void erase(size_t index, const std::string &key) {
+      auto &slot = slots[index];
+      if (slot.expiry != kNoExpiry) {
+        expiry_queue.erase({slot.expiry, key});
+      }
+      slot = Slot{};
+      // Если следующий слот пуст, цепочка пробирования здесь и так
+      // обрывается, и метка удаления не нужна.
+      size_t next = (index + 1) & (slots.size() - 1);
+      if (control[next] == kEmpty) {
+        control[index] = kEmpty;
+      } else {
+        control[index] = kDeleted;
+        ++deleted;
+      }
+      --size;
+    }
+
+    void rehash(size_t capacity) {
+      capacity = std::max(capacity, kMinCapacity);
+      auto old_control = std::exchange(control,
+                                       std::vector<uint8_t>(capacity, kEmpty));
+      auto old_slots = std::exchange(slots, std::vector<Slot>(capacity));
+      deleted = 0;
+      size_t mask = capacity - 1;
+      for (size_t j = 0; j < old_slots.size(); ++j) {
+        if (!isFull(old_control[j])) {
+          continue;
+        }
+        auto hash = kv_common::hashOf(old_slots[j].key);
+        size_t i = hash & mask;
+        while (isFull(control[i])) {
+          i = (i + 1) & mask;
+        }
+        control[i] = old_control[j];
+        slots[i] = std::move(old_slots[j]);
+      }
+    }
+
+    mutable Lock mutex;
+    std::vector<uint8_t> control;
+    std::vector<Slot> slots;
+    size_t size = 0;
+    size_t deleted = 0;
+    std::set<kv_common::ExpiryEntry> expiry_queue;
+  };
+
+  static uint8_t tagOf(uint64_t hash) {
+    return static_cast<uint8_t>(hash >> 57);
+  }
+
+  // Младшие биты хеша - позиция в таблице шарда, старшие 7 - метка,
+  // шард выбирается по битам между ними.
+  Shard &shardOf(uint64_t hash) { return shards_[(hash >> 32) & shard_mask_]; }
+
+  const Shard &shardOf(uint64_t hash) const {
+    return shards_[(hash >> 32) & shard_mask_];
+  }
+
+  kv_common::TickClock<Clock> clock_;
+  std::vector<Shard> shards_;
+  size_t shard_mask_;
+};
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "kv_thread_state.h"
+
+// Поиск самых частых ключей чтения и записи (KVStorageOptions::
+// hot_key_sample_one_in).
+namespace kv_hot {
+
+enum class Access { Read, Write };
+
+struct HotKey {
+  std::string key;
+  // Оценка числа обращений за запрошенные окна (с учётом выборки) и её
+  // возможное завышение.
+  uint64_t count = 0;
+  uint64_t error = 0;
+};
+
+// Алгоритм Space-Saving (Metwally и др.): не больше capacity счётчиков;
+// новый ключ при заполненной таблице занимает счётчик минимального
+// ключа и наследует его значение как ошибку. Ключ с частотой больше
+// n / capacity гарантированно в таблице.
+class SpaceSaving {
+public:
+  struct Counter {
+    uint64_t count = 0;
+    uint64_t error = 0;
+  };
+
+  explicit SpaceSaving(size_t capacity)
+      : capacity_(std::max<size_t>(capacity, 1)) {}
+
+  void add(std::string_view key) {
+    if (auto it = counters_.find(std::string(key)); it != end(counters_)) {
+      ++it->second.count;
+      return;
+    }
+    if (counters_.size() < capacity_) {
+      counters_.emplace(std::string(key), Counter{1, 0});
+      return;
+    }
+    // O(capacity), но сюда доходят только выбранные обращения.
+    auto min = std::min_element(
+        begin(counters_), end(counters_),
+        [](auto &a, auto &b) { return a.second.count < b.second.count; });
+    auto floor = min->second.count;
+    counters_.erase(min);
+    counters_.emplace(std::string(key), Counter{floor + 1, floor});
+  }
+
+  const std::unordered_map<std::string, Counter> &counters() const {
+    return counters_;
+  }
+
+private:
+  size_t capacity_;
+  std::unordered_map<std::string, Counter> counters_;
+};
+
+// Сэмплирует get/set: примерно раз в sample_one_in обращений потока
+// sample() возвращает true, и вызывающий передаёт ключ в add. Вне выборки
+// это декремент thread_local счётчика, мьютекс берётся только в add.
+// Окна длиной window (в единицах now, которые передаёт вызывающий)
+// сменяют друг друга; хранятся текущее и history завершённых, top
+// объединяет последние из них.
+class HotKeyTracker {
+public:
+  HotKeyTracker(uint32_t sample_one_in, size_t capacity, uint64_t window,
+                size_t history)
+      : sample_one_in_(std::max(sample_one_in, 1u)), capacity_(capacity),
+        window_(std::max<uint64_t>(window, 1)), history_(history) {}
+
+  bool sample() const {
+    auto &countdown = countdowns_.get([&] { return sample_one_in_; });
+    if (--countdown != 0) {
+      return false;
+    }
+    countdown = sample_one_in_;
+    return true;
+  }
+
+  void add(std::string_view key, Access access, uint64_t now) {
+    std::lock_guard l(mutex_);
+    rotate(now);
+    windows_.front().of(access).add(key);
+  }
+
+  // До k ключей с наибольшей оценкой за windows последних окон, включая
+  // текущее.
+  std::vector<HotKey> top(Access access, size_t k, size_t windows,
+                          uint64_t now) {
+    std::unordered_map<std::string, SpaceSaving::Counter> merged;
+    {
+      std::lock_guard l(mutex_);
+      rotate(now);
+      windows = std::min(windows, windows_.size());
+      for (size_t i = 0; i < windows; ++i) {
+        for (auto &[key, counter] : windows_[i].of(access).counters()) {
+          auto &total = merged[key];
+          total.count += counter.count;
+          total.error += counter.error;
+        }
+      }
+    }
+    std::vector<HotKey> result;
+    for (auto &[key, counter] : merged) {
+      result.push_back({key, counter.count * sample_one_in_,
+                        counter.error * sample_one_in_});
+    }
+    auto middle = begin(result) + std::min(k, result.size());
+    std::partial_sort(begin(result), middle, end(result),
+                      [](auto &a, auto &b) {
+                        return a.count != b.count ? a.count > b.count
+                                                  : a.key < b.key;
+                      });
+    result.erase(middle, end(result));
+    return result;
+  }
+
+private:
+  struct Window {
+    explicit Window(uint64_t start, size_t capacity)
+        : start(start), reads(capacity), writes(capacity) {}
+
+    SpaceSaving &of(Access access) {
+      return access == Access::Read ? reads : writes;
+    }
+
+    uint64_t start;
+    SpaceSaving reads;
+    SpaceSaving writes;
+  };
+
+  // Начинает новое окно, если текущее закончилось; окна без обращений
+  // тоже занимают место в истории, чтобы top(windows) означал время.
+  void rotate(uint64_t now) {
+    auto start = now - now % window_;
+    if (windows_.empty()) {
+      windows_.emplace_front(start, capacity_);
+      return;
+    }
+    auto last = windows_.front().start;
+    if (start <= last) {
+      return;
+    }
+    auto skipped = std::min<uint64_t>((start - last) / window_, history_ + 1);
+    for (uint64_t i = skipped; i != 0; --i) {
+      windows_.emplace_front(start - (i - 1) * window_, capacity_);
+    }
+    while (windows_.size() > history_ + 1) {
+      windows_.pop_back();
+    }
+  }
+
+  uint32_t sample_one_in_;
+  size_t capacity_;
+  uint64_t window_;
+  size_t history_;
+  kv_thread::PerThreadState<uint32_t> countdowns_;
+  std::mutex mutex_;
+  // windows_.front() - текущее окно.
+  std::deque<Window> windows_;
+};
+
+} // namespace kv_hot
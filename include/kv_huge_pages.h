@@ -0,0 +1,151 @@
+#pragma once
+
+#include <sys/mman.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+// Память на 2 МиБ страницах для узлов индекса KVStorage
+// (KVStorageOptions::huge_pages).
+namespace kv_memory {
+
+struct HugePageStats {
+  // Отображено с MAP_HUGETLB (явные huge pages из hugetlbfs).
+  size_t explicit_bytes = 0;
+  // Выровнено на 2 МиБ и помечено MADV_HUGEPAGE: THP, если включены.
+  size_t transparent_bytes = 0;
+  // madvise отказал - обычные страницы.
+  size_t regular_bytes = 0;
+};
+
+// Выдаёт память из 2 МиБ участков. Сначала пробует явные huge pages; если
+// они не зарезервированы (vm.nr_hugepages = 0), отображает выровненный
+// участок и просит THP через madvise; если и это недоступно, остаются
+// обычные страницы. Запросы меньше участка нарезаются из текущего участка
+// и возвращаются только при разрушении ресурса, поэтому ресурс ставится
+// под std::pmr::unsynchronized_pool_resource, который сам переиспользует
+// блоки. Запросы от kLargeRequest байт получают отдельное отображение и
+// освобождаются в deallocate; stats() тогда уменьшается на их размер.
+class HugePageResource : public std::pmr::memory_resource {
+public:
+  static constexpr size_t kHugePageSize = size_t{2} << 20;
+  static constexpr size_t kLargeRequest = kHugePageSize / 2;
+
+  HugePageResource() = default;
+  HugePageResource(const HugePageResource &) = delete;
+  HugePageResource &operator=(const HugePageResource &) = delete;
+
+  ~HugePageResource() override {
+    for (auto [address, size] : chunks_) {
+      munmap(address, size);
+    }
+  }
+
+  HugePageStats stats() const {
+    return {explicit_bytes_.load(std::memory_order_relaxed),
+            transparent_bytes_.load(std::memory_order_relaxed),
+            regular_bytes_.load(std::memory_order_relaxed)};
+  }
+
+private:
+  static size_t roundUp(size_t bytes, size_t to) {
+    return (bytes + to - 1) / to * to;
+  }
+
+  void *do_allocate(size_t bytes, size_t alignment) override {
+    if (bytes >= kLargeRequest || alignment > kHugePageSize) {
+      auto [p, counter] = map(roundUp(bytes, kHugePageSize));
+      std::lock_guard l(mutex_);
+      large_.emplace(p, counter);
+      return p;
+    }
+    std::lock_guard l(mutex_);
+    auto offset = roundUp(used_, alignment);
+    if (!current_ || offset + bytes > kHugePageSize) {
+      current_ = static_cast<char *>(map(kHugePageSize).address);
+      chunks_.emplace_back(current_, kHugePageSize);
+      offset = 0;
+    }
+    used_ = offset + bytes;
+    return current_ + offset;
+  }
+
+  void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+    if (bytes >= kLargeRequest || alignment > kHugePageSize) {
+      auto size = roundUp(bytes, kHugePageSize);
+      std::atomic<size_t> *counter;
+      {
+        std::lock_guard l(mutex_);
+        auto it = large_.find(p);
+        counter = it->second;
+        large_.erase(it);
+      }
+      munmap(p, size);
+      counter->fetch_sub(size, std::memory_order_relaxed);
+    }
+  }
+
+  bool do_is_equal(const memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+
+  // Отображение и счётчик stats(), к которому отнесён его размер.
+  struct Mapping {
+    void *address;
+    std::atomic<size_t> *counter;
+  };
+
+  // size кратен kHugePageSize.
+  Mapping map(size_t size) {
+#ifdef MAP_HUGETLB
+    void *huge = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (huge != MAP_FAILED) {
+      explicit_bytes_.fetch_add(size, std::memory_order_relaxed);
+      return {huge, &explicit_bytes_};
+    }
+#endif
+    // Лишние 2 МиБ, чтобы выровнять начало; хвосты возвращаются ядру.
+    size_t padded = size + kHugePageSize;
+    void *raw = mmap(nullptr, padded, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    auto begin = reinterpret_cast<uintptr_t>(raw);
+    auto aligned = roundUp(begin, kHugePageSize);
+    if (aligned != begin) {
+      munmap(raw, aligned - begin);
+    }
+    if (auto tail = begin + padded - (aligned + size); tail != 0) {
+      munmap(reinterpret_cast<void *>(aligned + size), tail);
+    }
+    auto *p = reinterpret_cast<void *>(aligned);
+#ifdef MADV_HUGEPAGE
+    if (madvise(p, size, MADV_HUGEPAGE) == 0) {
+      transparent_bytes_.fetch_add(size, std::memory_order_relaxed);
+      return {p, &transparent_bytes_};
+    }
+#endif
+    regular_bytes_.fetch_add(size, std::memory_order_relaxed);
+    return {p, &regular_bytes_};
+  }
+
+  std::mutex mutex_;
+  std::vector<std::pair<void *, size_t>> chunks_;
+  // Отдельные отображения больших запросов и их счётчики.
+  std::unordered_map<void *, std::atomic<size_t> *> large_;
+  char *current_ = nullptr;
+  size_t used_ = 0;
+  std::atomic<size_t> explicit_bytes_{0};
+  std::atomic<size_t> transparent_bytes_{0};
+  std::atomic<size_t> regular_bytes_{0};
+};
+
+} // namespace kv_memory
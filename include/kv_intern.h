@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+
+// Разделяемые значения для KVStorageOptions::intern_max_value_size.
+namespace kv_intern {
+
+struct InternStats {
+  // Различных разделяемых значений в таблице.
+  size_t values = 0;
+  // Записей, которые на них ссылаются.
+  size_t references = 0;
+  // Байт буферов значений, которые не пришлось выделять: по size() + 1 на
+  // каждую ссылку, кроме первой.
+  size_t bytes_saved = 0;
+};
+
+// Значения со счётчиками ссылок. Строки лежат в узлах unordered_map и не
+// перемещаются при рехеше, поэтому записи хранят указатель на строку.
+// Синхронизации нет: KVStorage меняет таблицу под эксклюзивной
+// блокировкой, а читатели под shared только разыменовывают указатели.
+// Счётчики атомарные, чтобы stats() читался без блокировки.
+class ValueTable {
+public:
+  const std::string *acquire(std::string value) {
+    auto [it, inserted] = refs_.try_emplace(std::move(value), 0);
+    if (inserted) {
+      values_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      bytes_saved_.fetch_add(it->first.size() + 1, std::memory_order_relaxed);
+    }
+    ++it->second;
+    references_.fetch_add(1, std::memory_order_relaxed);
+    return &it->first;
+  }
+
+  void release(const std::string *value) {
+    auto it = refs_.find(*value);
+    references_.fetch_sub(1, std::memory_order_relaxed);
+    if (--it->second == 0) {
+      refs_.erase(it);
+      values_.fetch_sub(1, std::memory_order_relaxed);
+    } else {
+      bytes_saved_.fetch_sub(it->first.size() + 1, std::memory_order_relaxed);
+    }
+  }
+
+  InternStats stats() const {
+    return {values_.load(std::memory_order_relaxed),
+            references_.load(std::memory_order_relaxed),
+            bytes_saved_.load(std::memory_order_relaxed)};
+  }
+
+private:
+  std::unordered_map<std::string, size_t> refs_;
+  std::atomic<size_t> values_{0};
+  std::atomic<size_t> references_{0};
+  std::atomic<size_t> bytes_saved_{0};
+};
+
+} // namespace kv_intern
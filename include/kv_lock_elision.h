@@ -0,0 +1,246 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <shared_mutex>
+#include <utility>
+
+#if (defined(__x86_64__) || defined(__i386__)) &&                              \
+    (defined(__GNUC__) || defined(__clang__))
+#define KV_LOCK_HAS_RTM 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#include "kv_rw_lock.h"
+
+// Элизия блокировки для KVStorage<Clock, Lock>: короткие операции
+// выполняются как аппаратные транзакции и не пишут в общую блокировку.
+// При абортах после kMaxAttempts попыток операция берёт Underlying.
+namespace kv_lock {
+
+// Intel TSX/RTM. Наличие проверяется через CPUID во время выполнения.
+struct RtmBackend {
+  static bool available() {
+#ifdef KV_LOCK_HAS_RTM
+    static const bool rtm = [] {
+      unsigned eax, ebx, ecx, edx;
+      if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return false;
+      }
+      return (ebx & (1u << 11)) != 0;
+    }();
+    return rtm;
+#else
+    return false;
+#endif
+  }
+
+#ifdef KV_LOCK_HAS_RTM
+  // После аборта выполнение возвращается сюда же с откатом памяти,
+  // поэтому begin может вернуть управление, оставаясь в транзакции.
+  __attribute__((target("rtm"), noinline)) bool begin(bool) {
+    return _xbegin() == _XBEGIN_STARTED;
+  }
+  __attribute__((target("rtm"), noinline)) void commit(bool) { _xend(); }
+  __attribute__((target("rtm"), noinline)) void abort(bool) { _xabort(0xff); }
+  __attribute__((target("rtm"), noinline)) bool inTransaction() const {
+    return _xtest() != 0;
+  }
+#else
+  bool begin(bool) { return false; }
+  void commit(bool) {}
+  void abort(bool) {}
+  bool inTransaction() const { return false; }
+#endif
+  // Конфликты с держателями Underlying обнаруживает само железо.
+  void drain(bool) {}
+};
+
+// Программная эмуляция тех же состояний для машин без TSX и для тестов.
+// "Транзакции" читателей идут параллельно, писателей - по одной; fallback
+// дожидается завершения начатых транзакций через drain. abort_one_in
+// принудительно обрывает каждую N-ю транзакцию.
+struct EmulatedBackend {
+  explicit EmulatedBackend(uint32_t abort_one_in = 0)
+      : abort_one_in_(abort_one_in) {}
+
+  static bool available() { return true; }
+
+  bool begin(bool write) {
+    if (abort_one_in_ != 0 &&
+        attempts_.fetch_add(1, std::memory_order_relaxed) % abort_one_in_ ==
+            0) {
+      return false;
+    }
+    if (write) {
+      transactions_.lock();
+    } else {
+      transactions_.lock_shared();
+    }
+    current_ = this;
+    return true;
+  }
+
+  void commit(bool write) {
+    current_ = nullptr;
+    if (write) {
+      transactions_.unlock();
+    } else {
+      transactions_.unlock_shared();
+    }
+  }
+
+  void abort(bool write) { commit(write); }
+
+  bool inTransaction() const { return current_ == this; }
+
+  void drain(bool write) {
+    if (write) {
+      transactions_.lock();
+      transactions_.unlock();
+    } else {
+      transactions_.lock_shared();
+      transactions_.unlock_shared();
+    }
+  }
+
+private:
+  static inline thread_local const EmulatedBackend *current_ = nullptr;
+  uint32_t abort_one_in_;
+  std::atomic<uint32_t> attempts_{0};
+  std::shared_mutex transactions_;
+};
+
+struct ElisionStats {
+  uint64_t elided = 0;
+  uint64_t aborts = 0;
+  uint64_t fallbacks = 0;
+};
+
+template <typename Underlying = std::shared_mutex,
+          typename Backend = RtmBackend>
+class ElidedSharedMutex {
+public:
+  static constexpr int kMaxAttempts = 3;
+
+  // Аргументы передаются конструктору Backend.
+  template <typename... Args>
+  explicit ElidedSharedMutex(Args &&...args)
+      : backend_(std::forward<Args>(args)...) {}
+  ElidedSharedMutex(const ElidedSharedMutex &) = delete;
+  ElidedSharedMutex &operator=(const ElidedSharedMutex &) = delete;
+
+  void lock() {
+    if (tryElide(true)) {
+      return;
+    }
+    underlying_.lock();
+    enterFallback(fallback_writers_, true);
+  }
+
+  bool try_lock() {
+    if (tryElide(true)) {
+      return true;
+    }
+    if (!underlying_.try_lock()) {
+      return false;
+    }
+    enterFallback(fallback_writers_, true);
+    return true;
+  }
+
+  void unlock() {
+    if (backend_.inTransaction()) {
+      backend_.commit(true);
+      elided_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    fallback_writers_.fetch_sub(1, std::memory_order_release);
+    underlying_.unlock();
+  }
+
+  void lock_shared() {
+    if (tryElide(false)) {
+      return;
+    }
+    underlying_.lock_shared();
+    enterFallback(fallback_readers_, false);
+  }
+
+  bool try_lock_shared() {
+    if (tryElide(false)) {
+      return true;
+    }
+    if (!underlying_.try_lock_shared()) {
+      return false;
+    }
+    enterFallback(fallback_readers_, false);
+    return true;
+  }
+
+  void unlock_shared() {
+    if (backend_.inTransaction()) {
+      backend_.commit(false);
+      elided_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    fallback_readers_.fetch_sub(1, std::memory_order_release);
+    underlying_.unlock_shared();
+  }
+
+  ElisionStats stats() const {
+    return {elided_.load(std::memory_order_relaxed),
+            aborts_.load(std::memory_order_relaxed),
+            fallbacks_.load(std::memory_order_relaxed)};
+  }
+
+  static bool elisionAvailable() { return Backend::available(); }
+
+private:
+  bool tryElide(bool write) {
+    if (!Backend::available()) {
+      return false;
+    }
+    for (int attempt = 0; attempt < kMaxAttempts; ++attempt) {
+      // Транзакция заведомо оборвётся, пока Underlying занят.
+      if (fallbackActive(write)) {
+        break;
+      }
+      if (!backend_.begin(write)) {
+        aborts_.fetch_add(1, std::memory_order_relaxed);
+        continue;
+      }
+      // Счётчики попадают в read set транзакции: захват Underlying
+      // другим потоком оборвёт её. Писать в общие счётчики внутри
+      // транзакции нельзя, поэтому elided_ растёт в unlock.
+      if (!fallbackActive(write)) {
+        return true;
+      }
+      backend_.abort(write);
+      aborts_.fetch_add(1, std::memory_order_relaxed);
+    }
+    fallbacks_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  bool fallbackActive(bool write) const {
+    return fallback_writers_.load(std::memory_order_seq_cst) != 0 ||
+           (write && fallback_readers_.load(std::memory_order_seq_cst) != 0);
+  }
+
+  void enterFallback(std::atomic<uint32_t> &counter, bool write) {
+    counter.fetch_add(1, std::memory_order_seq_cst);
+    backend_.drain(write);
+  }
+
+  Underlying underlying_;
+  Backend backend_;
+  alignas(64) std::atomic<uint32_t> fallback_writers_{0};
+  std::atomic<uint32_t> fallback_readers_{0};
+  alignas(64) std::atomic<uint64_t> elided_{0};
+  std::atomic<uint64_t> aborts_{0};
+  std::atomic<uint64_t> fallbacks_{0};
+};
+
+} // namespace kv_lock
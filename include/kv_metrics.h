@@ -0,0 +1,172 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// Экспорт метрик KVStorage в текстовом формате OpenMetrics
+// (KVStorage::openMetrics) и гистограммы задержек операций
+// (KVStorageOptions::latency_histograms).
+namespace kv_metrics {
+
+// Корзина i - задержки [2^(i-1), 2^i) нс, последняя - всё длиннее
+// 2^(kLatencyBuckets-2) нс (около 4.6 минуты).
+inline constexpr size_t kLatencyBuckets = 40;
+
+struct LatencySnapshot {
+  std::array<uint64_t, kLatencyBuckets> counts{};
+  uint64_t count = 0;
+  std::chrono::nanoseconds sum{0};
+};
+
+// Гистограмма без блокировок: запись - два relaxed fetch_add и один на
+// корзину. Снимок читает счётчики по отдельности и может разойтись с
+// count на операции, записанные во время чтения.
+class LatencyHistogram {
+public:
+  void record(std::chrono::nanoseconds latency) {
+    auto ns = static_cast<uint64_t>(std::max<int64_t>(latency.count(), 0));
+    auto bucket = std::min<size_t>(std::bit_width(ns), kLatencyBuckets - 1);
+    counts_[bucket].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_ns_.fetch_add(ns, std::memory_order_relaxed);
+  }
+
+  LatencySnapshot snapshot() const {
+    LatencySnapshot result;
+    for (size_t i = 0; i < kLatencyBuckets; ++i) {
+      result.counts[i] = counts_[i].load(std::memory_order_relaxed);
+    }
+    result.count = count_.load(std::memory_order_relaxed);
+    result.sum = std::chrono::nanoseconds(
+        sum_ns_.load(std::memory_order_relaxed));
+    return result;
+  }
+
+private:
+  std::array<std::atomic<uint64_t>, kLatencyBuckets> counts_{};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> sum_ns_{0};
+};
+
+using Labels = std::initializer_list<std::pair<std::string_view,
+                                               std::string_view>>;
+
+// Построчная запись экспозиции OpenMetrics. Семейство объявляется
+// family(), затем идут его сэмплы; finish() дописывает "# EOF".
+class Writer {
+public:
+  // type - counter, gauge или histogram. У counter сэмплы получают
+  // суффикс _total.
+  void family(std::string_view name, std::string_view type,
+              std::string_view help) {
+    family_ = name;
+    suffix_ = type == "counter" ? "_total" : "";
+    out_ += "# TYPE ";
+    out_ += name;
+    out_ += ' ';
+    out_ += type;
+    out_ += "\n# HELP ";
+    out_ += name;
+    out_ += ' ';
+    appendEscaped(help);
+    out_ += '\n';
+  }
+
+  void sample(Labels labels, uint64_t value) {
+    line(suffix_, labels, {}, std::to_string(value));
+  }
+
+  void sample(Labels labels, double value) {
+    line(suffix_, labels, {}, number(value));
+  }
+
+  // Сэмплы гистограммы задержек в секундах: накопленные _bucket, +Inf,
+  // _count и _sum. Корзины 0..i - задержки до 2^i - 1 нс включительно,
+  // это и есть граница le.
+  void histogram(Labels labels, const LatencySnapshot &snapshot) {
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i + 1 < kLatencyBuckets; ++i) {
+      cumulative += snapshot.counts[i];
+      auto le = number(static_cast<double>((uint64_t{1} << i) - 1) / 1e9);
+      line("_bucket", labels, le, std::to_string(cumulative));
+    }
+    cumulative += snapshot.counts[kLatencyBuckets - 1];
+    line("_bucket", labels, "+Inf", std::to_string(cumulative));
+    line("_count", labels, {}, std::to_string(cumulative));
+    line("_sum", labels, {},
+         number(std::chrono::duration<double>(snapshot.sum).count()));
+  }
+
+  std::string finish() {
+    out_ += "# EOF\n";
+    return std::move(out_);
+  }
+
+private:
+  // Кратчайшая запись, которая читается обратно в то же число.
+  static std::string number(double value) {
+    char buffer[32];
+    auto end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+    return std::string(buffer, end);
+  }
+
+  void line(std::string_view suffix, Labels labels, std::string_view le,
+            const std::string &value) {
+    out_ += family_;
+    out_ += suffix;
+    if (labels.size() != 0 || !le.empty()) {
+      char separator = '{';
+      for (auto &[name, label] : labels) {
+        appendLabel(separator, name, label);
+        separator = ',';
+      }
+      if (!le.empty()) {
+        appendLabel(separator, "le", le);
+      }
+      out_ += '}';
+    }
+    out_ += ' ';
+    out_ += value;
+    out_ += '\n';
+  }
+
+  void appendLabel(char separator, std::string_view name,
+                   std::string_view value) {
+    out_ += separator;
+    out_ += name;
+    out_ += "=\"";
+    appendEscaped(value);
+    out_ += '"';
+  }
+
+  // Экранирование HELP и значений меток: \, " и перевод строки.
+  void appendEscaped(std::string_view text) {
+    for (char c : text) {
+      if (c == '\\') {
+        out_ += "\\\\";
+      } else if (c == '\n') {
+        out_ += "\\n";
+      } else if (c == '"') {
+        out_ += "\\\"";
+      } else {
+        out_ += c;
+      }
+    }
+  }
+
+  std::string out_;
+  std::string family_;
+  std::string_view suffix_;
+};
+
+} // namespace kv_metrics
@@ -0,0 +1,263 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <new>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Политики блокировки для KVStorage<Clock, Lock>. Любой тип с интерфейсом
+// std::shared_mutex подходит в качестве Lock.
+namespace kv_lock {
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#else
+  std::this_thread::yield();
+#endif
+}
+
+// Reader-writer lock для коротких критических секций: сначала ограниченное
+// число итераций активного ожидания, затем парковка на futex через
+// std::atomic::wait. Пишущие имеют приоритет: пока писатель ждёт, новые
+// читатели не входят.
+class AdaptiveSharedMutex {
+public:
+  static constexpr int kSpinIterations = 128;
+
+  AdaptiveSharedMutex() = default;
+  AdaptiveSharedMutex(const AdaptiveSharedMutex &) = delete;
+  AdaptiveSharedMutex &operator=(const AdaptiveSharedMutex &) = delete;
+
+  void lock() {
+    if (try_lock()) {
+      return;
+    }
+    waiting_writers_.fetch_add(1, std::memory_order_acq_rel);
+    int spins = 0;
+    while (true) {
+      uint32_t s = state_.load(std::memory_order_relaxed);
+      if ((s & (kWriter | kReadersMask)) == 0) {
+        uint32_t next = kWriter;
+        if (waiting_writers_.load(std::memory_order_acquire) > 1) {
+          next |= kWriterWaiting;
+        }
+        if (state_.compare_exchange_weak(s, next, std::memory_order_acquire,
+                                         std::memory_order_relaxed)) {
+          waiting_writers_.fetch_sub(1, std::memory_order_acq_rel);
+          return;
+        }
+        continue;
+      }
+      if (!(s & kWriterWaiting)) {
+        state_.compare_exchange_weak(s, s | kWriterWaiting,
+                                     std::memory_order_relaxed);
+        continue;
+      }
+      if (spins++ < kSpinIterations) {
+        cpuRelax();
+      } else {
+        state_.wait(s, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool try_lock() {
+    uint32_t s = 0;
+    return state_.compare_exchange_strong(s, kWriter, std::memory_order_acquire,
+                                          std::memory_order_relaxed);
+  }
+
+  // Бит kWriterWaiting снимается вместе с kWriter, если ждущих писателей
+  // нет: иначе бит, выставленный по устаревшему счётчику, не пускал бы
+  // читателей до прихода следующего писателя. Писатель, пришедший после
+  // проверки, выставит бит заново в своём цикле.
+  void unlock() {
+    uint32_t s = state_.load(std::memory_order_relaxed);
+    uint32_t next;
+    do {
+      next = s & ~kWriter;
+      if (waiting_writers_.load(std::memory_order_acquire) == 0) {
+        next &= ~kWriterWaiting;
+      }
+    } while (!state_.compare_exchange_weak(s, next, std::memory_order_release,
+                                           std::memory_order_relaxed));
+    state_.notify_all();
+  }
+
+  void lock_shared() {
+    int spins = 0;
+    while (true) {
+      uint32_t s = state_.load(std::memory_order_relaxed);
+      if (!(s & (kWriter | kWriterWaiting))) {
+        if (state_.compare_exchange_weak(s, s + 1, std::memory_order_acquire,
+                                         std::memory_order_relaxed)) {
+          return;
+        }
+        continue;
+      }
+      if (spins++ < kSpinIterations) {
+        cpuRelax();
+      } else {
+        state_.wait(s, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool try_lock_shared() {
+    uint32_t s = state_.load(std::memory_order_relaxed);
+    while (!(s & (kWriter | kWriterWaiting))) {
+      if (state_.compare_exchange_weak(s, s + 1, std::memory_order_acquire,
+                                       std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void unlock_shared() {
+    uint32_t prev = state_.fetch_sub(1, std::memory_order_release);
+    if ((prev & kReadersMask) == 1 && (prev & kWriterWaiting)) {
+      state_.notify_all();
+    }
+  }
+
+private:
+  static constexpr uint32_t kWriter = 1u << 31;
+  static constexpr uint32_t kWriterWaiting = 1u << 30;
+  static constexpr uint32_t kReadersMask = kWriterWaiting - 1;
+
+  std::atomic<uint32_t> state_{0};
+  std::atomic<uint32_t> waiting_writers_{0};
+};
+
+// BRAVO (Biased Locking for Reader-Writer Locks, Dice & Kogan 2019) поверх
+// Underlying. Пока bias включён, читатель публикует себя в своём слоте
+// таблицы и не трогает общий счётчик, так что чтения на разных ядрах не
+// делят кэш-линию. Писатель выключает bias и ждёт опустошения таблицы;
+// повторно bias включается не раньше, чем через kInhibitMultiplier времени
+// этого ожидания.
+template <typename Underlying = AdaptiveSharedMutex> class BravoSharedMutex {
+public:
+  static constexpr size_t kSlots = 64;
+  static constexpr int kInhibitMultiplier = 9;
+
+  BravoSharedMutex() = default;
+  BravoSharedMutex(const BravoSharedMutex &) = delete;
+  BravoSharedMutex &operator=(const BravoSharedMutex &) = delete;
+
+  void lock() {
+    underlying_.lock();
+    if (bias_.load(std::memory_order_relaxed)) {
+      bias_.store(false, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      auto start = std::chrono::steady_clock::now();
+      for (auto &slot : slots_) {
+        while (slot.reader.load(std::memory_order_acquire) != nullptr) {
+          cpuRelax();
+        }
+      }
+      auto now = std::chrono::steady_clock::now();
+      inhibit_until_.store(
+          (now + (now - start) * kInhibitMultiplier).time_since_epoch().count(),
+          std::memory_order_relaxed);
+    }
+  }
+
+  bool try_lock() {
+    if (!underlying_.try_lock()) {
+      return false;
+    }
+    bias_.store(false, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (auto &slot : slots_) {
+      if (slot.reader.load(std::memory_order_acquire) != nullptr) {
+        underlying_.unlock();
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void unlock() { underlying_.unlock(); }
+
+  void lock_shared() {
+    if (tryFastShared()) {
+      return;
+    }
+    underlying_.lock_shared();
+    maybeEnableBias();
+  }
+
+  bool try_lock_shared() {
+    if (tryFastShared()) {
+      return true;
+    }
+    if (!underlying_.try_lock_shared()) {
+      return false;
+    }
+    maybeEnableBias();
+    return true;
+  }
+
+  void unlock_shared() {
+    auto &slot = mySlot();
+    if (slot.reader.load(std::memory_order_relaxed) == &token_) {
+      slot.reader.store(nullptr, std::memory_order_release);
+      return;
+    }
+    underlying_.unlock_shared();
+  }
+
+private:
+  struct alignas(64) Slot {
+    std::atomic<const void *> reader{nullptr};
+  };
+
+  Slot &mySlot() {
+    auto p = reinterpret_cast<uintptr_t>(&token_);
+    return slots_[((p ^ (p >> 12)) * 0x9E3779B97F4A7C15ull >> 58) % kSlots];
+  }
+
+  bool tryFastShared() {
+    if (!bias_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    auto &slot = mySlot();
+    const void *expected = nullptr;
+    if (!slot.reader.compare_exchange_strong(expected, &token_,
+                                             std::memory_order_seq_cst)) {
+      return false;
+    }
+    if (bias_.load(std::memory_order_seq_cst)) {
+      return true;
+    }
+    slot.reader.store(nullptr, std::memory_order_release);
+    return false;
+  }
+
+  void maybeEnableBias() {
+    if (!bias_.load(std::memory_order_relaxed) &&
+        std::chrono::steady_clock::now().time_since_epoch().count() >=
+            inhibit_until_.load(std::memory_order_relaxed)) {
+      bias_.store(true, std::memory_order_release);
+    }
+  }
+
+  static inline thread_local char token_;
+
+  std::atomic<bool> bias_{true};
+  std::atomic<int64_t> inhibit_until_{0};
+  std::array<Slot, kSlots> slots_;
+  Underlying underlying_;
+};
+
+} // namespace kv_lock
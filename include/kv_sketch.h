@@ -0,0 +1,244 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Распределения размеров и сроков жизни записей для
+// KVStorageOptions::distribution_stats. Обновляются при каждой вставке и
+// удалении, поэтому запрос не обходит записи.
+namespace kv_sketch {
+
+// Логарифмическая гистограмма: корзина 0 - значение 0, корзина i -
+// значения [2^(i-1), 2^i).
+class Log2Histogram {
+public:
+  static constexpr size_t kBuckets = 65;
+
+  static size_t bucketOf(uint64_t value) { return std::bit_width(value); }
+
+  static uint64_t lowerBound(size_t bucket) {
+    return bucket == 0 ? 0 : uint64_t{1} << (bucket - 1);
+  }
+
+  void add(uint64_t value, uint64_t count = 1) {
+    counts_[bucketOf(value)] += count;
+    total_ += count;
+  }
+
+  void remove(uint64_t value, uint64_t count = 1) {
+    counts_[bucketOf(value)] -= count;
+    total_ -= count;
+  }
+
+  uint64_t count(size_t bucket) const { return counts_[bucket]; }
+  uint64_t total() const { return total_; }
+
+  // Нижняя граница корзины, в которую попадает квантиль q из [0, 1].
+  uint64_t quantile(double q) const {
+    auto rank = static_cast<uint64_t>(q * static_cast<double>(total_));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; ++i) {
+      seen += counts_[i];
+      if (seen > rank) {
+        return lowerBound(i);
+      }
+    }
+    return total_ ? lowerBound(kBuckets - 1) : 0;
+  }
+
+private:
+  std::array<uint64_t, kBuckets> counts_{};
+  uint64_t total_ = 0;
+};
+
+struct PrefixCounts {
+  uint64_t records = 0;
+  uint64_t bytes = 0;
+};
+
+// Записи и байты по префиксу ключа: до первого delimiter включительно,
+// не длиннее kMaxLength; ключ без разделителя относится к префиксу "".
+// Различных префиксов не больше max_prefixes, остальные считаются в
+// other(). Префикс, попавший в таблицу, из неё не удаляется, поэтому
+// удаление записи всегда вычитается оттуда же, куда её посчитали.
+class PrefixCounter {
+public:
+  static constexpr size_t kMaxLength = 64;
+
+  PrefixCounter(char delimiter, size_t max_prefixes)
+      : delimiter_(delimiter), max_prefixes_(max_prefixes) {}
+
+  void add(std::string_view key, uint64_t bytes) {
+    auto &counts = find(key, true);
+    ++counts.records;
+    counts.bytes += bytes;
+  }
+
+  void remove(std::string_view key, uint64_t bytes) {
+    auto &counts = find(key, false);
+    --counts.records;
+    counts.bytes -= bytes;
+  }
+
+  // До n префиксов с наибольшим числом записей.
+  std::vector<std::pair<std::string, PrefixCounts>> top(size_t n) const {
+    std::vector<std::pair<std::string, PrefixCounts>> result;
+    for (auto &[prefix, counts] : counts_) {
+      if (counts.records != 0) {
+        result.emplace_back(prefix, counts);
+      }
+    }
+    auto middle = begin(result) + std::min(n, result.size());
+    std::partial_sort(begin(result), middle, end(result),
+                      [](auto &a, auto &b) {
+                        return a.second.records > b.second.records;
+                      });
+    result.erase(middle, end(result));
+    return result;
+  }
+
+  PrefixCounts other() const { return other_; }
+
+private:
+  std::string_view prefixOf(std::string_view key) const {
+    auto end = key.find(delimiter_);
+    if (end == std::string_view::npos) {
+      return {};
+    }
+    return key.substr(0, std::min(end + 1, kMaxLength));
+  }
+
+  PrefixCounts &find(std::string_view key, bool insert) {
+    auto prefix = prefixOf(key);
+    if (auto it = counts_.find(prefix); it != end(counts_)) {
+      return it->second;
+    }
+    if (insert && counts_.size() < max_prefixes_) {
+      return counts_.emplace(std::string(prefix), PrefixCounts{})
+          .first->second;
+    }
+    return other_;
+  }
+
+  char delimiter_;
+  size_t max_prefixes_;
+  std::map<std::string, PrefixCounts, std::less<>> counts_;
+  PrefixCounts other_;
+};
+
+// Распределения одного пространства имён. Сроки истечения хранятся
+// абсолютными (в секундах от эпохи хранилища) с точностью до секунды, а
+// гистограмма оставшегося TTL ведётся на момент прошлого запроса
+// (remaining_at_). Запрос переносит между корзинами только секунды,
+// перешедшие с тех пор границу 2^k, и находит их по lower_bound: каждая
+// секунда переходит не больше 64 раз, так что запрос амортизированно
+// O(64 log n), а не O(число различных секунд).
+class Distribution {
+public:
+  Distribution(char delimiter, size_t max_prefixes)
+      : prefixes_(delimiter, max_prefixes) {}
+
+  // expiry_second пуст для записей без срока.
+  void add(std::string_view key, size_t value_size,
+           const std::optional<uint64_t> &expiry_second) {
+    key_sizes_.add(key.size());
+    value_sizes_.add(value_size);
+    prefixes_.add(key, key.size() + value_size);
+    if (expiry_second) {
+      ++expiries_[*expiry_second];
+      remaining_.add(remainingAt(*expiry_second, remaining_at_));
+    } else {
+      ++without_ttl_;
+    }
+  }
+
+  void remove(std::string_view key, size_t value_size,
+              const std::optional<uint64_t> &expiry_second) {
+    key_sizes_.remove(key.size());
+    value_sizes_.remove(value_size);
+    prefixes_.remove(key, key.size() + value_size);
+    if (expiry_second) {
+      auto it = expiries_.find(*expiry_second);
+      if (--it->second == 0) {
+        expiries_.erase(it);
+      }
+      remaining_.remove(remainingAt(*expiry_second, remaining_at_));
+    } else {
+      --without_ttl_;
+    }
+  }
+
+  const Log2Histogram &keySizes() const { return key_sizes_; }
+  const Log2Histogram &valueSizes() const { return value_sizes_; }
+  const PrefixCounter &prefixes() const { return prefixes_; }
+  uint64_t withoutTtl() const { return without_ttl_; }
+
+  // Оставшийся TTL в секундах на момент now_second; истёкшие, но ещё не
+  // удалённые записи попадают в корзину 0. Вызывается под shared-
+  // блокировкой хранилища, параллельные запросы разделяет mutex_.
+  Log2Histogram remainingTtl(uint64_t now_second) const {
+    std::lock_guard l(mutex_);
+    if (now_second < remaining_at_) {
+      // Часы назад не идут; на всякий случай - пересчёт целиком.
+      remaining_ = {};
+      for (auto [second, count] : expiries_) {
+        remaining_.add(remainingAt(second, now_second), count);
+      }
+    } else {
+      advance(now_second);
+    }
+    remaining_at_ = now_second;
+    return remaining_;
+  }
+
+private:
+  static uint64_t remainingAt(uint64_t second, uint64_t now_second) {
+    return second > now_second ? second - now_second : 0;
+  }
+
+  // Секунда s переходит границу 2^k, когда s - remaining_at_ >= 2^k, а
+  // s - now_second < 2^k, то есть s из [remaining_at_ + 2^k,
+  // now_second + 2^k). Окна по k идут по возрастанию и могут
+  // перекрываться, поэтому каждое начинается не раньше конца прошлого.
+  void advance(uint64_t now_second) const {
+    if (now_second == remaining_at_ || expiries_.empty()) {
+      return;
+    }
+    auto last = expiries_.rbegin()->first;
+    uint64_t done = 0;
+    for (size_t k = 0; k < 64; ++k) {
+      auto step = uint64_t{1} << k;
+      if (step > last - std::min(last, remaining_at_)) {
+        break;
+      }
+      auto from = std::max(remaining_at_ + step, done);
+      done = now_second + std::min(step, ~uint64_t{0} - now_second);
+      for (auto it = expiries_.lower_bound(from);
+           it != end(expiries_) && it->first < done; ++it) {
+        remaining_.remove(remainingAt(it->first, remaining_at_), it->second);
+        remaining_.add(remainingAt(it->first, now_second), it->second);
+      }
+    }
+  }
+
+  Log2Histogram key_sizes_;
+  Log2Histogram value_sizes_;
+  PrefixCounter prefixes_;
+  std::map<uint64_t, uint64_t> expiries_;
+  mutable std::mutex mutex_;
+  mutable Log2Histogram remaining_;
+  mutable uint64_t remaining_at_ = 0;
+  uint64_t without_ttl_ = 0;
+};
+
+} // namespace kv_sketch
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Журнал медленных операций KVStorage (KVStorageOptions::slowlog_capacity).
+namespace kv_slowlog {
+
+enum class Operation : uint8_t {
+  Get,
+  GetMany,
+  GetManySorted,
+  Set,
+  Remove,
+};
+
+inline constexpr size_t kOperations = 5;
+
+inline const char *name(Operation operation) {
+  switch (operation) {
+  case Operation::Get:
+    return "get";
+  case Operation::GetMany:
+    return "getMany";
+  case Operation::GetManySorted:
+    return "getManySorted";
+  case Operation::Set:
+    return "set";
+  case Operation::Remove:
+    return "remove";
+  }
+  return "unknown";
+}
+
+struct Entry {
+  Operation operation = Operation::Get;
+  // Первые kMaxKey байт ключа (у getMany - первого ключа).
+  std::string key;
+  // Ключей у getMany, записей в ответе у getManySorted, иначе 1.
+  uint32_t count = 1;
+  // Ожидание блокировки (у getManySorted - всех повторных взятий) и
+  // остальное время операции.
+  std::chrono::nanoseconds lock_wait{0};
+  std::chrono::nanoseconds execution{0};
+  std::chrono::system_clock::time_point time;
+};
+
+inline constexpr size_t kMaxKey = 32;
+
+// Замер одной операции: от создания до stop(). Выключенный таймер часы
+// не читает. Ключ не копируется: он должен жить до конца операции, а
+// SlowLog копирует его, только если операция попала в журнал.
+class OpTimer {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // Отсчёт начинается с ожидания блокировки.
+  OpTimer(bool enabled, std::string_view key) : enabled_(enabled) {
+    if (enabled_) {
+      key_ = key.substr(0, kMaxKey);
+      start_ = wait_start_ = Clock::now();
+    }
+  }
+
+  // Ключ переехал, пока операция шла (store перемещает его в запись).
+  void rekey(std::string_view key) {
+    if (enabled_) {
+      key_ = key.substr(0, kMaxKey);
+    }
+  }
+
+  void locked() {
+    if (enabled_) {
+      wait_ += Clock::now() - wait_start_;
+    }
+  }
+
+  void unlocked() {
+    if (enabled_) {
+      wait_start_ = Clock::now();
+    }
+  }
+
+  void stop() {
+    if (enabled_) {
+      stop_ = Clock::now();
+    }
+  }
+
+  bool enabled() const { return enabled_; }
+  std::string_view key() const { return key_; }
+  Clock::duration wait() const { return wait_; }
+  Clock::duration elapsed() const { return stop_ - start_; }
+
+private:
+  bool enabled_;
+  std::string_view key_;
+  Clock::time_point start_;
+  Clock::time_point stop_;
+  Clock::time_point wait_start_;
+  Clock::duration wait_{0};
+};
+
+// Кольцо последних capacity медленных операций без блокировок. Писатель
+// получает номер fetch_add и захватывает слот CAS по счётчику версии
+// (нечётный - слот пишется); если слот занят другим писателем, запись
+// теряется. Читатель копирует слот и принимает копию, только если версия
+// до и после одинакова и чётна (seqlock). Поля хранятся в атомарных
+// словах, так что гонки чтения и записи определены.
+class SlowLog {
+public:
+  SlowLog(size_t capacity, std::chrono::nanoseconds threshold)
+      : capacity_(std::max<size_t>(capacity, 1)),
+        slots_(std::make_unique<Slot[]>(capacity_)), threshold_(threshold) {}
+
+  // Записывает остановленную операцию, если она заняла не меньше
+  // threshold.
+  void finish(const OpTimer &timer, Operation operation, uint32_t count) {
+    if (!timer.enabled()) {
+      return;
+    }
+    auto elapsed = timer.elapsed();
+    if (elapsed < threshold_) {
+      return;
+    }
+    auto ticket = next_.fetch_add(1, std::memory_order_relaxed);
+    auto &slot = slots_[ticket % capacity_];
+    auto version = slot.version.load(std::memory_order_relaxed);
+    if ((version & 1) != 0 ||
+        !slot.version.compare_exchange_strong(version, version + 1,
+                                              std::memory_order_acq_rel)) {
+      return;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+
+    auto key = timer.key();
+    auto wait = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        timer.wait());
+    auto total =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed);
+    auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch());
+    std::array<uint64_t, kWords> words{};
+    words[0] = ticket;
+    words[1] = static_cast<uint64_t>(operation) |
+               static_cast<uint64_t>(key.size()) << 8 |
+               static_cast<uint64_t>(count) << 32;
+    words[2] = static_cast<uint64_t>(wait.count());
+    words[3] = static_cast<uint64_t>((total - wait).count());
+    words[4] = static_cast<uint64_t>(now.count());
+    std::memcpy(&words[kHeaderWords], key.data(), key.size());
+    for (size_t i = 0; i < kWords; ++i) {
+      slot.words[i].store(words[i], std::memory_order_relaxed);
+    }
+    slot.version.store(version + 2, std::memory_order_release);
+  }
+
+  // Записи кольца от новых к старым.
+  std::vector<Entry> entries() const {
+    std::vector<std::pair<uint64_t, Entry>> copies;
+    for (size_t s = 0; s < capacity_; ++s) {
+      auto &slot = slots_[s];
+      auto before = slot.version.load(std::memory_order_acquire);
+      if (before == 0 || (before & 1) != 0) {
+        continue;
+      }
+      std::array<uint64_t, kWords> words;
+      for (size_t i = 0; i < kWords; ++i) {
+        words[i] = slot.words[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.version.load(std::memory_order_relaxed) != before) {
+        continue;
+      }
+      Entry entry;
+      entry.operation = static_cast<Operation>(words[1] & 0xff);
+      auto key_size = std::min<size_t>((words[1] >> 8) & 0xff, kMaxKey);
+      entry.key.assign(reinterpret_cast<const char *>(&words[kHeaderWords]),
+                       key_size);
+      entry.count = static_cast<uint32_t>(words[1] >> 32);
+      entry.lock_wait = std::chrono::nanoseconds(words[2]);
+      entry.execution = std::chrono::nanoseconds(words[3]);
+      entry.time = std::chrono::system_clock::time_point(
+          std::chrono::duration_cast<std::chrono::system_clock::duration>(
+              std::chrono::nanoseconds(words[4])));
+      copies.emplace_back(words[0], std::move(entry));
+    }
+    std::sort(begin(copies), end(copies),
+              [](auto &a, auto &b) { return a.first > b.first; });
+    std::vector<Entry> result;
+    for (auto &[_, entry] : copies) {
+      result.push_back(std::move(entry));
+    }
+    return result;
+  }
+
+private:
+  // Номер, операция с длиной ключа и count, ожидание, выполнение, время;
+  // затем ключ.
+  static constexpr size_t kHeaderWords = 5;
+  static constexpr size_t kWords = kHeaderWords + kMaxKey / 8;
+
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> version{0};
+    std::array<std::atomic<uint64_t>, kWords> words{};
+  };
+
+  size_t capacity_;
+  std::unique_ptr<Slot[]> slots_;
+  std::chrono::nanoseconds threshold_;
+  std::atomic<uint64_t> next_{0};
+};
+
+} // namespace kv_slowlog
@@ -1,117 +1,1595 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <map>
+#include <memory>
+#include <memory_resource>
 #include <mutex>
 #include <optional>
+#include <random>
 #include <set>
 #include <shared_mutex>
 #include <span>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <tuple>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
-template <typename Clock = std::chrono::system_clock> class KVStorage {
+#include "kv_access.h"
+#include "kv_admission.h"
+#include "kv_common.h"
+#include "kv_hot_keys.h"
+#include "kv_huge_pages.h"
+#include "kv_intern.h"
+#include "kv_metrics.h"
+#include "kv_sketch.h"
+#include "kv_slowlog.h"
+#include "kv_trace.h"
+#include "kv_tree_cursor.h"
+
+struct KVStorageOptions {
+  // Случайная добавка из [0, expiry_jitter) к каждому относительному TTL,
+  // чтобы записи, загруженные одновременно, не истекали в одну секунду.
+  std::chrono::milliseconds expiry_jitter{0};
+  // Сколько истёкших записей в секунду разрешено удалять через
+  // removeOneExpiredEntry/removeExpiredEntries. 0 - без ограничения.
+  uint32_t max_expirations_per_second = 0;
+  // Лимиты пространства имён по умолчанию, см. NamespaceOptions.
+  size_t max_records = 0;
+  size_t max_bytes = 0;
+  // Размер выборки при вытеснении.
+  uint32_t eviction_samples = 5;
+  // Допуск записей (set, setWithDeadline, trySet): не больше
+  // max_writes_per_second записей и max_write_bytes_per_second байт ключей
+  // и значений в секунду с запасом на admission_burst. 0 - без ограничения.
+  // set при исчерпании лимита ждёт, trySet отказывает. Лимиты считаются по
+  // steady_clock, а не по часам хранилища.
+  double max_writes_per_second = 0;
+  double max_write_bytes_per_second = 0;
+  std::chrono::milliseconds admission_burst{1000};
+  // Приоритет читателей: пока get/getManySorted ждут блокировку, запись
+  // откладывается, но не дольше reader_priority_max_wait.
+  bool reader_priority = false;
+  std::chrono::microseconds reader_priority_max_wait{100};
+  // getManySorted отпускает блокировку после каждых scan_chunk_size
+  // просмотренных записей. 0 - весь обход под одной блокировкой.
+  uint32_t scan_chunk_size = 1024;
+  // Запись последовательностей get для построения подсказки relayout:
+  // примерно раз в access_sample_one_in обращений записываются следующие
+  // access_sequence_length ключей потока; хранится не больше
+  // access_max_sequences последовательностей. 0 - запись выключена.
+  uint32_t access_sample_one_in = 0;
+  uint32_t access_sequence_length = 16;
+  size_t access_max_sequences = 4096;
+  // Узлы индекса на 2 МиБ страницах (kv_memory::HugePageResource): явные
+  // huge pages, если зарезервированы, иначе THP через madvise, иначе
+  // обычные страницы. Значения длиннее SSO остаются в обычной куче.
+  bool huge_pages = false;
+  // getMany ищет ключи группами по prefetch_group, чередуя шаги поиска;
+  // getManySorted подгружает значения на prefetch_group записей вперёд.
+  // 0 - без чередования и prefetch.
+  uint32_t prefetch_group = 8;
+  // getMany ведёт prefetch_group поисков корутинами (kv_tree::
+  // interleavedFind): закончивший поиск сразу берёт следующий ключ.
+  bool coroutine_lookups = false;
+  // Значения длиннее буфера SSO (15 байт в libstdc++) и не длиннее
+  // intern_max_value_size хранятся в одном экземпляре на хранилище, а
+  // записи ссылаются на него. Короткие значения буфера в куче не имеют и
+  // не разделяются. 0 - без разделения.
+  size_t intern_max_value_size = 0;
+  // Гистограммы размеров ключей и значений, оставшегося TTL и счётчики по
+  // префиксам ключей (до первого prefix_delimiter, не больше max_prefixes
+  // различных) для distributionStats. Обновляются при вставке и удалении.
+  bool distribution_stats = false;
+  char prefix_delimiter = ':';
+  size_t max_prefixes = 1024;
+  // Горячие ключи (hotKeys): примерно раз в hot_key_sample_one_in
+  // обращений потока ключ get/getMany или set/remove попадает в сводку
+  // Space-Saving на hot_key_capacity ключей. Сводки ведутся окнами по
+  // hot_key_window, кроме текущего хранится hot_key_history завершённых.
+  // 0 - выключено.
+  uint32_t hot_key_sample_one_in = 0;
+  size_t hot_key_capacity = 128;
+  std::chrono::milliseconds hot_key_window{10000};
+  size_t hot_key_history = 5;
+  // Журнал медленных операций (slowlog): get, getMany, getManySorted,
+  // set и remove (и их варианты с Namespace и сроком), занявшие не меньше
+  // slowlog_threshold вместе с ожиданием блокировки, попадают в кольцо
+  // на slowlog_capacity записей. 0 - журнал выключен.
+  size_t slowlog_capacity = 0;
+  std::chrono::microseconds slowlog_threshold{10000};
+  // Гистограммы задержек операций для openMetrics (тот же замер, что у
+  // slowlog).
+  bool latency_histograms = false;
+};
+
+// Квоты пространства имён. При превышении вытесняется самая давно
+// читавшаяся из eviction_samples случайных записей этого пространства
+// (приближённый LRU, как в Redis). 0 - без ограничения.
+struct NamespaceOptions {
+  size_t max_records = 0;
+  size_t max_bytes = 0;
+};
+
+struct AdmissionStats {
+  uint64_t admitted = 0;
+  uint64_t rejected = 0;
+  uint64_t delayed = 0;
+  std::chrono::nanoseconds total_delay{0};
+  uint64_t reader_yields = 0;
+  // tryGet/tryGetManySorted, не дождавшиеся блокировки.
+  uint64_t read_timeouts = 0;
+};
+
+struct NamespaceStats {
+  size_t records = 0;
+  size_t bytes = 0;
+  uint64_t gets = 0;
+  uint64_t hits = 0;
+  uint64_t sets = 0;
+  uint64_t removes = 0;
+  uint64_t evictions = 0;
+  uint64_t expirations = 0;
+};
+
+// Пусто, если distribution_stats выключен.
+struct DistributionStats {
+  kv_sketch::Log2Histogram key_sizes;
+  kv_sketch::Log2Histogram value_sizes;
+  // Оставшийся TTL в секундах (с округлением вверх) у записей со сроком.
+  kv_sketch::Log2Histogram remaining_ttl;
+  uint64_t without_ttl = 0;
+  // Префиксы по убыванию числа записей и всё, что не поместилось в
+  // max_prefixes.
+  std::vector<std::pair<std::string, kv_sketch::PrefixCounts>> prefixes;
+  kv_sketch::PrefixCounts other_prefixes;
+};
+
+// Ответ tryGetManySorted. Если срок истёк посреди обхода, truncated
+// выставлен, records - начало диапазона, а продолжить можно вызовом с
+// key = resume_key (последний просмотренный ключ, возможно истёкший).
+struct SortedScan {
+  std::vector<std::pair<std::string, std::string>> records;
+  bool truncated = false;
+  std::string resume_key;
+};
+
+struct ExpiredBacklog {
+  uint64_t records = 0;
+  uint64_t bytes = 0;
+};
+
+struct NamespaceMetrics {
+  std::string name;
+  NamespaceStats stats;
+  // Истёкшие, но ещё не удалённые removeOneExpiredEntry записи и их
+  // размер (как в stats.bytes).
+  uint64_t expired_records = 0;
+  uint64_t expired_bytes = 0;
+  // Верхняя граница глубины красно-чёрного дерева индекса,
+  // 2 ceil(log2(n + 1)).
+  uint64_t index_depth_bound = 0;
+};
+
+// Снимок для openMetrics.
+struct MetricsSnapshot {
+  std::vector<NamespaceMetrics> namespaces;
+  AdmissionStats admission;
+  kv_intern::InternStats intern;
+  kv_memory::HugePageStats huge_pages;
+  // Пусто без latency_histograms.
+  std::vector<std::pair<kv_slowlog::Operation, kv_metrics::LatencySnapshot>>
+      latencies;
+};
+
+// Текст экспозиции OpenMetrics (и Prometheus) для снимка metrics().
+inline std::string renderOpenMetrics(const MetricsSnapshot &snapshot) {
+  kv_metrics::Writer out;
+  auto perNamespace = [&](std::string_view name, std::string_view type,
+                          std::string_view help, auto value) {
+    out.family(name, type, help);
+    for (auto &space : snapshot.namespaces) {
+      out.sample({{"namespace", space.name}},
+                 static_cast<uint64_t>(value(space)));
+    }
+  };
+  perNamespace("kv_records", "gauge", "Records in the namespace.",
+               [](auto &s) { return s.stats.records; });
+  perNamespace("kv_bytes", "gauge",
+               "Keys, values and per-record overhead in bytes.",
+               [](auto &s) { return s.stats.bytes; });
+  perNamespace("kv_expired_records", "gauge",
+               "Expired records not yet removed.",
+               [](auto &s) { return s.expired_records; });
+  perNamespace("kv_expired_bytes", "gauge",
+               "Bytes held by expired records not yet removed.",
+               [](auto &s) { return s.expired_bytes; });
+  perNamespace("kv_index_depth_bound", "gauge",
+               "Upper bound of the index tree depth.",
+               [](auto &s) { return s.index_depth_bound; });
+  perNamespace("kv_gets", "counter", "get lookups, including getMany keys.",
+               [](auto &s) { return s.stats.gets; });
+  perNamespace("kv_hits", "counter", "get lookups that found a live record.",
+               [](auto &s) { return s.stats.hits; });
+  perNamespace("kv_sets", "counter", "Records written.",
+               [](auto &s) { return s.stats.sets; });
+  perNamespace("kv_removes", "counter", "Records removed by remove.",
+               [](auto &s) { return s.stats.removes; });
+  perNamespace("kv_evictions", "counter", "Records evicted by quota.",
+               [](auto &s) { return s.stats.evictions; });
+  perNamespace("kv_expirations", "counter", "Expired records removed.",
+               [](auto &s) { return s.stats.expirations; });
+
+  auto global = [&](std::string_view name, std::string_view type,
+                    std::string_view help, auto value) {
+    out.family(name, type, help);
+    out.sample({}, value);
+  };
+  auto &admission = snapshot.admission;
+  global("kv_writes_admitted", "counter", "Writes admitted by rate limits.",
+         admission.admitted);
+  global("kv_writes_rejected", "counter", "Writes rejected by trySet.",
+         admission.rejected);
+  global("kv_writes_delayed", "counter", "Writes delayed by rate limits.",
+         admission.delayed);
+  global("kv_write_delay_seconds", "counter",
+         "Time writes spent waiting for rate limits.",
+         std::chrono::duration<double>(admission.total_delay).count());
+  global("kv_reader_yields", "counter",
+         "Times a writer yielded to waiting readers.",
+         admission.reader_yields);
+  global("kv_read_timeouts", "counter",
+         "tryGet calls that missed their deadline.", admission.read_timeouts);
+  global("kv_interned_values", "gauge", "Distinct shared values.",
+         static_cast<uint64_t>(snapshot.intern.values));
+  global("kv_interned_references", "gauge",
+         "Records referencing shared values.",
+         static_cast<uint64_t>(snapshot.intern.references));
+  global("kv_interned_saved_bytes", "gauge",
+         "Value bytes saved by sharing.",
+         static_cast<uint64_t>(snapshot.intern.bytes_saved));
+
+  out.family("kv_huge_page_bytes", "gauge",
+             "Index memory mapped for huge_pages.");
+  auto &huge = snapshot.huge_pages;
+  out.sample({{"kind", "explicit"}},
+             static_cast<uint64_t>(huge.explicit_bytes));
+  out.sample({{"kind", "transparent"}},
+             static_cast<uint64_t>(huge.transparent_bytes));
+  out.sample({{"kind", "regular"}}, static_cast<uint64_t>(huge.regular_bytes));
+
+  if (!snapshot.latencies.empty()) {
+    out.family("kv_operation_latency_seconds", "histogram",
+               "Operation latency including lock wait.");
+    for (auto &[operation, latency] : snapshot.latencies) {
+      out.histogram({{"operation", kv_slowlog::name(operation)}}, latency);
+    }
+  }
+  return out.finish();
+}
+
+template <typename Clock = std::chrono::steady_clock,
+          typename Lock = std::shared_mutex>
+class KVStorage {
 public:
+  // Время истечения хранится в тиках Clock::duration от эпохи хранилища
+  // (kv_common::TickClock).
+  static constexpr uint64_t kNoExpiry = kv_common::kNoExpiry;
+
   struct Record {
     std::string value;
-    std::optional<typename Clock::time_point> expiry;
+    uint64_t expiry;
+    // Время последнего доступа в миллисекундах от эпохи (по модулю 2^32).
+    // Обновляется в get под shared-блокировкой, поэтому через atomic_ref.
+    mutable uint32_t last_access = 0;
+    // Позиция в Space::slots, если у пространства есть квота (до 2^31
+    // записей в пространстве).
+    uint32_t slot : 31 = 0;
+    // Значение разделяемое (intern_max_value_size): value хранит без кучи
+    // только указатель на строку таблицы. Читать через valueOf.
+    uint32_t interned : 1 = 0;
+  };
+
+  // Пространство имён: свои индекс, очередь истечения, квоты и метрики.
+  // Методы без Namespace работают с kDefaultNamespace.
+  struct Namespace {
+    uint32_t id = 0;
+    bool operator==(const Namespace &) const = default;
   };
+  static constexpr Namespace kDefaultNamespace{};
+
+  // Учитываемый в квоте max_bytes размер записи сверх ключа и значения:
+  // Record, std::string ключа и узел std::map.
+  static constexpr size_t kRecordOverhead =
+      sizeof(Record) + sizeof(std::string) + 32;
 
   explicit KVStorage(
       std::span<std::tuple<std::string, std::string, uint32_t>> entries,
-      Clock clock = Clock{})
-      : clock_(clock) {
+      Clock clock = Clock{}, KVStorageOptions options = {})
+      : clock_(clock), options_(options),
+        expiration_tokens_(options.max_expirations_per_second),
+        last_refill_(0),
+        write_bucket_(options.max_writes_per_second,
+                      burstTokens(options.max_writes_per_second, options)),
+        write_bytes_bucket_(
+            options.max_write_bytes_per_second,
+            burstTokens(options.max_write_bytes_per_second, options)) {
+    if (options.access_sample_one_in != 0) {
+      recorder_ = std::make_unique<kv_access::AccessRecorder>(
+          options.access_sample_one_in, options.access_sequence_length,
+          options.access_max_sequences);
+    }
+    if (options.slowlog_capacity != 0) {
+      slowlog_ = std::make_unique<kv_slowlog::SlowLog>(
+          options.slowlog_capacity, options.slowlog_threshold);
+    }
+    if (options.latency_histograms) {
+      latencies_ = std::make_unique<std::array<kv_metrics::LatencyHistogram,
+                                               kv_slowlog::kOperations>>();
+    }
+    if (options.hot_key_sample_one_in != 0) {
+      hot_keys_ = std::make_unique<kv_hot::HotKeyTracker>(
+          options.hot_key_sample_one_in, options.hot_key_capacity,
+          static_cast<uint64_t>(options.hot_key_window.count()),
+          options.hot_key_history);
+    }
+    if (options.huge_pages) {
+      huge_pages_ = std::make_unique<kv_memory::HugePageResource>();
+    }
+    spaces_.push_back(newSpace(
+        "", NamespaceOptions{options.max_records, options.max_bytes}));
+    default_space_ = spaces_.front().get();
+    // Пустое имя - пространство по умолчанию, а не ещё одно.
+    namespace_ids_.emplace("", kDefaultNamespace);
+    // Начальная загрузка не проходит допуск записей.
     for (auto &[key, value, ttl] : entries) {
-      set(key, value, ttl);
+      store(kDefaultNamespace, key, value, std::chrono::seconds(ttl));
     }
   }
 
-  void set(std::string key, std::string value, uint32_t ttl = 0) {
+  // Возвращает пространство имён name, создавая его при первом вызове.
+  // Квоты задаются при создании и у существующего пространства не меняются.
+  Namespace createNamespace(std::string_view name,
+                            NamespaceOptions options = {}) {
     std::unique_lock l(mutex_);
-    auto expiry = (ttl != 0)
-                      ? std::optional{clock_.now() + std::chrono::seconds(ttl)}
-                      : std::nullopt;
+    if (auto it = namespace_ids_.find(name); it != end(namespace_ids_)) {
+      return it->second;
+    }
+    Namespace ns{static_cast<uint32_t>(spaces_.size())};
+    spaces_.push_back(newSpace(std::string(name), options));
+    spaces_[ns.id - 1]->next.store(spaces_.back().get(),
+                                   std::memory_order_release);
+    namespace_ids_.emplace(std::string(name), ns);
+    return ns;
+  }
 
-    records_[key] = {std::move(value), expiry};
-    if (expiry) {
-      expiry_queue_.insert({*expiry, key});
+  std::optional<Namespace> findNamespace(std::string_view name) const {
+    std::shared_lock l(mutex_);
+    if (auto it = namespace_ids_.find(name); it != end(namespace_ids_)) {
+      return it->second;
     }
+    return std::nullopt;
   }
 
-  bool remove(std::string_view key) {
-    std::unique_lock l(mutex_);
-    auto it = records_.find(std::string(key));
-    if (it == end(records_)) {
+  NamespaceStats namespaceStats(Namespace ns = kDefaultNamespace) const {
+    std::shared_lock l(mutex_);
+    auto &space = spaceOf(ns);
+    auto &c = space.counters;
+    return {space.records.size(),
+            space.bytes,
+            c.gets(),
+            c.hits(),
+            c.sets.load(std::memory_order_relaxed),
+            c.removes.load(std::memory_order_relaxed),
+            c.evictions.load(std::memory_order_relaxed),
+            c.expirations.load(std::memory_order_relaxed)};
+  }
+
+  void set(std::string key, std::string value, uint32_t ttl = 0) {
+    set(kDefaultNamespace, std::move(key), std::move(value), ttl);
+  }
+
+  void set(Namespace ns, std::string key, std::string value,
+           uint32_t ttl = 0) {
+    set(ns, std::move(key), std::move(value), std::chrono::seconds(ttl));
+  }
+
+  // TTL с точностью до Clock::duration. Нулевой TTL означает запись без
+  // истечения.
+  template <typename Rep, typename Period>
+  void set(std::string key, std::string value,
+           std::chrono::duration<Rep, Period> ttl) {
+    set(kDefaultNamespace, std::move(key), std::move(value), ttl);
+  }
+
+  template <typename Rep, typename Period>
+  void set(Namespace ns, std::string key, std::string value,
+           std::chrono::duration<Rep, Period> ttl) {
+    admitWrite(key.size() + value.size());
+    store(ns, std::move(key), std::move(value), ttl);
+  }
+
+  // Как set, но при исчерпании лимита записи возвращает false, не
+  // дожидаясь токенов.
+  bool trySet(std::string key, std::string value, uint32_t ttl = 0) {
+    return trySet(kDefaultNamespace, std::move(key), std::move(value), ttl);
+  }
+
+  bool trySet(Namespace ns, std::string key, std::string value,
+              uint32_t ttl = 0) {
+    if (!tryAdmitWrite(key.size() + value.size())) {
       return false;
     }
+    store(ns, std::move(key), std::move(value), std::chrono::seconds(ttl));
+    return true;
+  }
+
+  // Абсолютный срок жизни. Срок по другим часам (например, system_clock
+  // из репликации) переводится в Clock через текущее время обоих часов.
+  template <typename DeadlineClock, typename Duration>
+  void setWithDeadline(
+      std::string key, std::string value,
+      std::chrono::time_point<DeadlineClock, Duration> deadline) {
+    setWithDeadline(kDefaultNamespace, std::move(key), std::move(value),
+                    deadline);
+  }
+
+  template <typename DeadlineClock, typename Duration>
+  void setWithDeadline(
+      Namespace ns, std::string key, std::string value,
+      std::chrono::time_point<DeadlineClock, Duration> deadline) {
+    admitWrite(key.size() + value.size());
+    typename Clock::time_point local;
+    if constexpr (std::is_same_v<DeadlineClock,
+                                 typename Clock::time_point::clock>) {
+      local = std::chrono::time_point_cast<typename Clock::duration>(deadline);
+    } else {
+      local = clock_.now() + std::chrono::ceil<typename Clock::duration>(
+                                 deadline - DeadlineClock::now());
+    }
+    store(ns, std::move(key), std::move(value),
+          [expiry = clock_.toTick(local)] { return expiry; });
+  }
+
+  bool remove(std::string_view key) { return remove(kDefaultNamespace, key); }
 
-    if (it->second.expiry) {
-      expiry_queue_.erase({*it->second.expiry, it->first});
+  bool remove(Namespace ns, std::string_view key) {
+    KV_TRACE3(remove_entry, ns.id, key.data(), key.size());
+    trackHotKey(key, kv_hot::Access::Write);
+    auto timer = opTimer(key);
+    auto l = writeLock();
+    timer.locked();
+    auto &space = spaceOf(ns);
+    auto it = space.records.find(std::string(key));
+    bool found = it != end(space.records);
+    if (found) {
+      eraseRecord(space, it);
+      space.counters.removes.fetch_add(1, std::memory_order_relaxed);
     }
-    records_.erase(it);
-    return true;
+    finishOp(timer, kv_slowlog::Operation::Remove, 1);
+    KV_TRACE2(remove_return, ns.id, found);
+    return found;
   }
 
   std::optional<std::string> get(std::string_view key) const {
-    std::shared_lock l(mutex_);
-    auto it = records_.find(std::string(key));
-    if (it == end(records_)) {
+    return get(kDefaultNamespace, key);
+  }
+
+  std::optional<std::string> get(Namespace ns, std::string_view key) const {
+    KV_TRACE3(get_entry, ns.id, key.data(), key.size());
+    auto timer = opTimer(key);
+    auto l = readLock();
+    timer.locked();
+    auto result = getLocked(spaceOf(ns), key);
+    finishOp(timer, kv_slowlog::Operation::Get, 1);
+    KV_TRACE2(get_return, ns.id, result.has_value());
+    return result;
+  }
+
+  // Значения keys[i] (или nullopt) под одной shared-блокировкой. Поиски
+  // идут группами по prefetch_group: за проход группа спускается на
+  // уровень дерева, и промахи кэша разных ключей перекрываются.
+  std::vector<std::optional<std::string>>
+  getMany(std::span<const std::string_view> keys) const {
+    return getMany(kDefaultNamespace, keys);
+  }
+
+  std::vector<std::optional<std::string>>
+  getMany(Namespace ns, std::span<const std::string_view> keys) const {
+    auto timer = opTimer(keys.empty() ? std::string_view() : keys[0]);
+    auto l = readLock();
+    timer.locked();
+    auto result = getManyLocked(spaceOf(ns), keys);
+    finishOp(timer, kv_slowlog::Operation::GetMany,
+             static_cast<uint32_t>(keys.size()));
+    return result;
+  }
+
+  std::vector<std::pair<std::string, std::string>>
+  getManySorted(std::string_view key, uint32_t count) const {
+    return getManySorted(kDefaultNamespace, key, count);
+  }
+
+  std::vector<std::pair<std::string, std::string>>
+  getManySorted(Namespace ns, std::string_view key, uint32_t count) const {
+    KV_TRACE4(get_many_sorted_entry, ns.id, key.data(), key.size(), count);
+    auto timer = opTimer(key);
+    auto l = readLock();
+    timer.locked();
+    auto result = scanSorted(ns, key, count, l, [&](auto &lock) {
+      lock.unlock();
+      timer.unlocked();
+      std::this_thread::yield();
+      lock = readLock();
+      timer.locked();
+      return true;
+    });
+    finishOp(timer, kv_slowlog::Operation::GetManySorted,
+             static_cast<uint32_t>(result.size()));
+    KV_TRACE2(get_many_sorted_return, ns.id, result.size());
+    return result;
+  }
+
+  // get с ограниченным ожиданием: если блокировку не удалось взять до
+  // deadline, возвращает промах. Срок задаётся по любым часам, обычно
+  // steady_clock, и не зависит от Clock хранилища.
+  template <typename DeadlineClock, typename Duration>
+  std::optional<std::string>
+  tryGet(std::string_view key,
+         std::chrono::time_point<DeadlineClock, Duration> deadline) const {
+    return tryGet(kDefaultNamespace, key, deadline);
+  }
+
+  template <typename DeadlineClock, typename Duration>
+  std::optional<std::string>
+  tryGet(Namespace ns, std::string_view key,
+         std::chrono::time_point<DeadlineClock, Duration> deadline) const {
+    KV_TRACE3(try_get_entry, ns.id, key.data(), key.size());
+    auto timer = opTimer(key);
+    auto l = readLockUntil(deadline);
+    if (!l.owns_lock()) {
+      KV_TRACE2(try_get_return, ns.id, false);
       return std::nullopt;
     }
+    timer.locked();
+    auto result = getLocked(spaceOf(ns), key);
+    finishOp(timer, kv_slowlog::Operation::Get, 1);
+    KV_TRACE2(try_get_return, ns.id, result.has_value());
+    return result;
+  }
+
+  // getManySorted с ограниченным ожиданием. nullopt, если блокировку не
+  // удалось взять до deadline. Если срок истёк посреди обхода, возвращается
+  // начало диапазона с truncated, см. SortedScan.
+  template <typename DeadlineClock, typename Duration>
+  std::optional<SortedScan>
+  tryGetManySorted(
+      std::string_view key, uint32_t count,
+      std::chrono::time_point<DeadlineClock, Duration> deadline) const {
+    return tryGetManySorted(kDefaultNamespace, key, count, deadline);
+  }
 
-    auto &[value, expire] = it->second;
-    if (expire && *expire <= clock_.now()) {
+  template <typename DeadlineClock, typename Duration>
+  std::optional<SortedScan>
+  tryGetManySorted(
+      Namespace ns, std::string_view key, uint32_t count,
+      std::chrono::time_point<DeadlineClock, Duration> deadline) const {
+    KV_TRACE4(try_get_many_sorted_entry, ns.id, key.data(), key.size(),
+              count);
+    auto timer = opTimer(key);
+    auto l = readLockUntil(deadline);
+    if (!l.owns_lock()) {
+      KV_TRACE3(try_get_many_sorted_return, ns.id, 0, true);
       return std::nullopt;
     }
-    return value;
+    timer.locked();
+    SortedScan result;
+    result.records = scanSorted(
+        ns, key, count, l,
+        [&](auto &lock) {
+          lock.unlock();
+          timer.unlocked();
+          std::this_thread::yield();
+          lock = readLockUntil(deadline);
+          timer.locked();
+          return lock.owns_lock();
+        },
+        &result.resume_key);
+    result.truncated = !l.owns_lock();
+    finishOp(timer, kv_slowlog::Operation::GetManySorted,
+             static_cast<uint32_t>(result.records.size()));
+    KV_TRACE3(try_get_many_sorted_return, ns.id, result.records.size(),
+              result.truncated);
+    return result;
   }
 
-  std::vector<std::pair<std::string, std::string>>
-  getManySorted(std::string_view key, uint32_t count) const {
-    std::shared_lock l(mutex_);
-    std::vector<std::pair<std::string, std::string>> result;
-    auto it = records_.lower_bound(std::string(key));
+  // Операции из журнала медленных операций от новых к старым; пусто, если
+  // slowlog_capacity == 0.
+  std::vector<kv_slowlog::Entry> slowlog() const {
+    return slowlog_ ? slowlog_->entries() : std::vector<kv_slowlog::Entry>{};
+  }
 
-    if (it != records_.end() && it->first == key) {
-      ++it;
+  // Записанные последовательности обращений или nullptr, если
+  // access_sample_one_in == 0.
+  const kv_access::AccessRecorder *accessRecorder() const {
+    return recorder_.get();
+  }
+
+  // Перекладывает записи пространства имён в новую арену: сначала ключи
+  // из order (подсказка kv_access::buildLayout), затем остальные по
+  // порядку. Узлы дерева совместно читаемых ключей оказываются в
+  // соседних кэш-линиях и страницах. Арена монотонная:
+  // память удалённых после relayout записей возвращается только при
+  // следующем relayout, поэтому он рассчитан на хранилища, которые после
+  // загрузки почти не меняются. Инвалидирует итераторы обходов.
+  void relayout(std::span<const std::string> order) {
+    relayout(kDefaultNamespace, order);
+  }
+
+  void relayout(Namespace ns, std::span<const std::string> order) {
+    std::unique_lock l(mutex_);
+    auto &space = spaceOf(ns);
+    // С huge_pages буферы арены не меньше kLargeRequest: такие получают
+    // свои отображения и возвращаются вместе с ареной.
+    size_t initial = huge_pages_ ? kv_memory::HugePageResource::kLargeRequest
+                                 : 4096;
+    auto arena = std::make_unique<std::pmr::monotonic_buffer_resource>(
+        std::max(space.bytes, initial), upstreamResource());
+    RecordMap records(arena.get());
+    auto copy = [&](typename RecordMap::iterator it) {
+      // Копия, а не перемещение: значение длиннее SSO получает новый
+      // буфер, и буферы соседних записей выделяются подряд.
+      auto &record = it->second;
+      records.emplace(it->first,
+                      Record{std::string(record.value), record.expiry,
+                             record.last_access, 0, record.interned});
+    };
+    for (auto &key : order) {
+      auto it = space.records.find(key);
+      if (it != end(space.records) && !records.contains(key)) {
+        copy(it);
+      }
+    }
+    for (auto it = begin(space.records); it != end(space.records); ++it) {
+      if (!records.contains(it->first)) {
+        copy(it);
+      }
+    }
+    // Старое дерево освобождается раньше своей арены. Присваивание
+    // pmr-контейнеров с разными ресурсами копировало бы узлы обратно в
+    // старую арену, поэтому дерево пересоздаётся на месте.
+    std::destroy_at(&space.records);
+    std::construct_at(&space.records, std::move(records));
+    space.arena = std::move(arena);
+    ++space.erase_version;
+    if (space.evictionEnabled()) {
+      space.slots.clear();
+      for (auto it = begin(space.records); it != end(space.records); ++it) {
+        it->second.slot = static_cast<uint32_t>(space.slots.size());
+        space.slots.push_back(it);
+      }
+    }
+  }
+
+  // Сколько памяти индекса получено каждым из способов; нули, если
+  // huge_pages выключен.
+  kv_memory::HugePageStats hugePageStats() const {
+    return huge_pages_ ? huge_pages_->stats() : kv_memory::HugePageStats{};
+  }
+
+  // До k самых частых ключей чтения или записи за windows последних окон
+  // hot_key_window, включая текущее. Счётчики - оценки Space-Saving,
+  // умноженные на hot_key_sample_one_in. Пусто, если поиск выключен.
+  std::vector<kv_hot::HotKey> hotKeys(kv_hot::Access access, size_t k = 10,
+                                      size_t windows = 1) const {
+    if (!hot_keys_) {
+      return {};
+    }
+    return hot_keys_->top(access, k, windows, nowMillis());
+  }
+
+  DistributionStats distributionStats(Namespace ns = kDefaultNamespace,
+                                      size_t top_prefixes = 32) const {
+    std::shared_lock l(mutex_);
+    auto &distribution = spaceOf(ns).distribution;
+    if (!distribution) {
+      return {};
     }
+    auto now = std::chrono::duration_cast<std::chrono::seconds>(
+                   typename Clock::duration(clock_.nowTick()))
+                   .count();
+    return {distribution->keySizes(),
+            distribution->valueSizes(),
+            distribution->remainingTtl(static_cast<uint64_t>(now)),
+            distribution->withoutTtl(),
+            distribution->prefixes().top(top_prefixes),
+            distribution->prefixes().other()};
+  }
 
-    while (it != end(records_) && result.size() < count) {
-      if (!it->second.expiry || *it->second.expiry > clock_.now()) {
-        result.emplace_back(it->first, it->second.value);
+  kv_intern::InternStats internStats() const {
+    std::shared_lock l(mutex_);
+    return interned_.stats();
+  }
+
+  // Истёкшие, но ещё не удалённые записи пространства имён и их размер.
+  // Счётчики ведутся при вставке и удалении; запрос только сдвигает
+  // границу истёкших по очереди истечения, амортизированно O(1).
+  ExpiredBacklog expiredBacklog(Namespace ns = kDefaultNamespace) const {
+    std::shared_lock l(mutex_);
+    auto &space = spaceOf(ns);
+    advanceBacklog(space, clock_.nowTick());
+    return {space.counters.expired.load(std::memory_order_relaxed),
+            space.counters.expired_bytes.load(std::memory_order_relaxed)};
+  }
+
+  // Снимок всех метрик для renderOpenMetrics. Счётчики и размеры - копии в
+  // атомарных переменных, пространства имён обходятся по цепочке next,
+  // поэтому снимок не ждёт блокировку. Граница истёкших записей
+  // сдвигается к текущему времени, только если shared-блокировку удалось
+  // взять сразу; иначе экспортируется счёт на прошлый сдвиг.
+  MetricsSnapshot metrics() const {
+    if (std::shared_lock l(mutex_, std::try_to_lock); l.owns_lock()) {
+      auto now = clock_.nowTick();
+      for (auto &space : spaces_) {
+        advanceBacklog(*space, now);
       }
-      ++it;
     }
-    return result;
+    MetricsSnapshot snapshot;
+    for (const Space *space = default_space_; space;
+         space = space->next.load(std::memory_order_acquire)) {
+      auto &c = space->counters;
+      auto records = c.records.load(std::memory_order_relaxed);
+      snapshot.namespaces.push_back(
+          {space->name,
+           {records, c.bytes.load(std::memory_order_relaxed),
+            c.gets(),
+            c.hits(),
+            c.sets.load(std::memory_order_relaxed),
+            c.removes.load(std::memory_order_relaxed),
+            c.evictions.load(std::memory_order_relaxed),
+            c.expirations.load(std::memory_order_relaxed)},
+           c.expired.load(std::memory_order_relaxed),
+           c.expired_bytes.load(std::memory_order_relaxed),
+           // ceil(log2(n + 1)) == bit_width(n).
+           2 * static_cast<uint64_t>(std::bit_width(records))});
+    }
+    snapshot.admission = admissionStats();
+    snapshot.intern = interned_.stats();
+    snapshot.huge_pages = hugePageStats();
+    if (latencies_) {
+      for (size_t i = 0; i < kv_slowlog::kOperations; ++i) {
+        snapshot.latencies.emplace_back(static_cast<kv_slowlog::Operation>(i),
+                                        (*latencies_)[i].snapshot());
+      }
+    }
+    return snapshot;
+  }
+
+  std::string openMetrics() const { return renderOpenMetrics(metrics()); }
+
+  AdmissionStats admissionStats() const {
+    return {admitted_.load(std::memory_order_relaxed),
+            rejected_.load(std::memory_order_relaxed),
+            delayed_.load(std::memory_order_relaxed),
+            std::chrono::nanoseconds(
+                delay_ns_.load(std::memory_order_relaxed)),
+            reader_yields_.load(std::memory_order_relaxed),
+            read_timeouts_.load(std::memory_order_relaxed)};
   }
 
+  // Удаляет запись с самым ранним истёкшим сроком среди всех пространств
+  // имён.
   std::optional<std::pair<std::string, std::string>> removeOneExpiredEntry() {
-    std::unique_lock l(mutex_);
-    auto it = begin(expiry_queue_);
-    if (it != end(expiry_queue_) && it->expiry <= clock_.now()) {
-      auto value = records_[it->key].value;
-      records_.erase(it->key);
-      expiry_queue_.erase(it);
-      return std::make_pair(it->key, value);
+    KV_TRACE(remove_expired_entry);
+    auto l = writeLock();
+    auto now = clock_.nowTick();
+    auto space = earliestExpiring(now);
+    if (space && takeExpirationTokens(now, 1) == 1) {
+      std::pair<std::string, std::string> result;
+      expireFirst(*space, now, &result);
+      KV_TRACE1(remove_expired_return, 1);
+      return result;
     }
+    KV_TRACE1(remove_expired_return, 0);
     return std::nullopt;
   }
 
+  // Удаляет до max_count истёкших записей за одно взятие блокировки.
+  // Возвращает число удалённых записей.
+  size_t removeExpiredEntries(size_t max_count) {
+    auto l = writeLock();
+    auto now = clock_.nowTick();
+    size_t budget = takeExpirationTokens(now, max_count);
+    size_t removed = 0;
+    while (removed < budget) {
+      auto space = earliestExpiring(now);
+      if (!space) {
+        break;
+      }
+      expireFirst(*space, now);
+      ++removed;
+    }
+    if (options_.max_expirations_per_second != 0) {
+      expiration_tokens_ += static_cast<double>(budget - removed);
+    }
+    return removed;
+  }
+
 private:
-  struct ExpiryEntry {
-    typename Clock::time_point expiry;
-    std::string key;
+  struct ExpiryEntry : kv_common::ExpiryEntry {
+    // recordBytes записи для счётчиков истёкших; в сравнении не участвует.
+    size_t bytes = 0;
+  };
+
+  // Длина значения, которое std::string хранит без буфера в куче.
+  static inline const size_t kInlineValueSize = std::string().capacity();
 
-    bool operator<(const ExpiryEntry &other) const {
-      return std::tie(expiry, key) < std::tie(other.expiry, other.key);
+  // pmr, чтобы relayout и huge_pages могли разместить узлы в своей арене.
+  using RecordMap = std::pmr::map<std::string, Record>;
+
+  // Счётчики get меняются под shared-блокировкой. Общий счётчик гонял бы
+  // свою кэш-линию между ядрами читателей и обрывал бы транзакции lock
+  // elision, поэтому у потока свой шард (поток получает номер по кругу),
+  // а чтение суммирует шарды.
+  static constexpr size_t kReadShards = 16;
+
+  struct alignas(64) ReadShard {
+    std::atomic<uint64_t> gets{0};
+    std::atomic<uint64_t> hits{0};
+  };
+
+  static size_t readShard() {
+    static std::atomic<size_t> next{0};
+    thread_local size_t shard =
+        next.fetch_add(1, std::memory_order_relaxed) % kReadShards;
+    return shard;
+  }
+
+  struct Counters {
+    std::array<ReadShard, kReadShards> reads;
+    std::atomic<uint64_t> sets{0};
+    std::atomic<uint64_t> removes{0};
+    std::atomic<uint64_t> evictions{0};
+    std::atomic<uint64_t> expirations{0};
+    // Копии records.size(), bytes и числа истёкших записей для metrics().
+    std::atomic<uint64_t> records{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> expired{0};
+    std::atomic<uint64_t> expired_bytes{0};
+
+    uint64_t gets() const {
+      uint64_t total = 0;
+      for (auto &shard : reads) {
+        total += shard.gets.load(std::memory_order_relaxed);
+      }
+      return total;
+    }
+
+    uint64_t hits() const {
+      uint64_t total = 0;
+      for (auto &shard : reads) {
+        total += shard.hits.load(std::memory_order_relaxed);
+      }
+      return total;
     }
   };
 
-  mutable std::shared_mutex mutex_;
-  std::map<std::string, Record> records_;
-  std::set<ExpiryEntry> expiry_queue_;
-  Clock clock_;
+  struct Space {
+    // upstream - ресурс huge pages или nullptr для обычной кучи.
+    Space(std::string name, NamespaceOptions options,
+          std::pmr::memory_resource *upstream)
+        : name(std::move(name)), options(options),
+          arena(upstream ? std::make_unique<
+                               std::pmr::unsynchronized_pool_resource>(upstream)
+                         : nullptr),
+          records(arena ? arena.get() : std::pmr::get_default_resource()),
+          frontier(expiry_queue.end()) {}
+
+    bool evictionEnabled() const {
+      return options.max_records != 0 || options.max_bytes != 0;
+    }
+
+    bool overQuota() const {
+      return (options.max_records != 0 &&
+              records.size() > options.max_records) ||
+             (options.max_bytes != 0 && bytes > options.max_bytes);
+    }
+
+    std::string name;
+    NamespaceOptions options;
+    // Пул над huge pages или арена последнего relayout; объявлена раньше
+    // records, чтобы пережить дерево.
+    std::unique_ptr<std::pmr::memory_resource> arena;
+    RecordMap records;
+    std::set<ExpiryEntry> expiry_queue;
+    // Граница истёкших: записи очереди до frontier имеют expiry <=
+    // expired_until и учтены в expired_records/expired_bytes, frontier -
+    // первая с expiry > expired_until. advanceBacklog сдвигает её
+    // вперёд по времени, вставка и удаление поправляют счётчики, так что
+    // каждая запись пересекает границу один раз. Под эксклюзивной
+    // блокировкой или под shared вместе с frontier_mutex.
+    uint64_t expired_until = 0;
+    typename std::set<ExpiryEntry>::iterator frontier;
+    uint64_t expired_records = 0;
+    uint64_t expired_bytes = 0;
+    std::mutex frontier_mutex;
+    // Плотный массив записей для случайной выборки при вытеснении.
+    std::vector<typename RecordMap::iterator> slots;
+    size_t bytes = 0;
+    // Число удалений, см. scanSorted.
+    uint64_t erase_version = 0;
+    // Только с distribution_stats.
+    std::unique_ptr<kv_sketch::Distribution> distribution;
+    // Следующее пространство в порядке создания: metrics() обходит их
+    // без блокировки, пока spaces_ может перевыделяться.
+    std::atomic<Space *> next{nullptr};
+    // Счётчики атомарные и не делят кэш-линии с остальными полями, шарды
+    // get - и друг с другом (ReadShard).
+    alignas(64) mutable Counters counters;
+  };
+
+  template <typename Rep, typename Period>
+  void store(Namespace ns, std::string key, std::string value,
+             std::chrono::duration<Rep, Period> ttl) {
+    store(ns, std::move(key), std::move(value), [this, ttl] {
+      if (ttl == ttl.zero()) {
+        return kNoExpiry;
+      }
+      return clock_.expiryAfter(ttl, jitter());
+    });
+  }
+
+  // Единственный путь записи после допуска. expiry() возвращает тик
+  // истечения или kNoExpiry и вызывается под блокировкой: jitter() берёт
+  // rng_.
+  template <typename Expiry>
+  void store(Namespace ns, std::string key, std::string value,
+             Expiry expiry) {
+    KV_TRACE4(set_entry, ns.id, key.data(), key.size(), value.size());
+    auto timer = opTimer(key);
+    yieldToReaders();
+    auto l = writeLock();
+    timer.locked();
+    timer.rekey(setLocked(spaceOf(ns), std::move(key), std::move(value),
+                          expiry()));
+    finishOp(timer, kv_slowlog::Operation::Set, 1);
+    KV_TRACE1(set_return, ns.id);
+  }
+
+  static double burstTokens(double rate, const KVStorageOptions &options) {
+    return rate *
+           std::chrono::duration<double>(options.admission_burst).count();
+  }
+
+  // Бакеты допуска пополняются по steady_clock, а не по Clock: set ждёт
+  // токены настоящим sleep_for, и при остановленных часах хранилища его
+  // долг не гасился бы.
+  static double admissionSeconds() {
+    return std::chrono::duration<double>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  bool tryAdmitWrite(size_t bytes) {
+    if (!write_bucket_.enabled() && !write_bytes_bucket_.enabled()) {
+      return true;
+    }
+    auto now = admissionSeconds();
+    if (!write_bucket_.tryTake(1, now)) {
+      rejected_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    if (!write_bytes_bucket_.tryTake(static_cast<double>(bytes), now)) {
+      write_bucket_.refund(1);
+      rejected_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    admitted_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Резервирует токены и ждёт, пока долг по обоим бакетам не погасится.
+  void admitWrite(size_t bytes) {
+    if (!write_bucket_.enabled() && !write_bytes_bucket_.enabled()) {
+      return;
+    }
+    auto now = admissionSeconds();
+    double wait = std::max(
+        write_bucket_.reserve(1, now),
+        write_bytes_bucket_.reserve(static_cast<double>(bytes), now));
+    admitted_.fetch_add(1, std::memory_order_relaxed);
+    if (wait > 0) {
+      auto delay = std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::duration<double>(wait));
+      delayed_.fetch_add(1, std::memory_order_relaxed);
+      delay_ns_.fetch_add(static_cast<uint64_t>(delay.count()),
+                          std::memory_order_relaxed);
+      std::this_thread::sleep_for(delay);
+    }
+  }
+
+  std::shared_lock<Lock> readLock() const {
+    KV_TRACE1(lock_acquire, 0);
+    if (options_.reader_priority) {
+      waiting_readers_.fetch_add(1, std::memory_order_relaxed);
+    }
+    std::shared_lock l(mutex_);
+    if (options_.reader_priority) {
+      waiting_readers_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    KV_TRACE1(lock_acquired, 0);
+    return l;
+  }
+
+  // Эксклюзивная блокировка операций записи с точками трассировки
+  // lock_acquire/lock_acquired.
+  std::unique_lock<Lock> writeLock() {
+    KV_TRACE1(lock_acquire, 1);
+    std::unique_lock l(mutex_);
+    KV_TRACE1(lock_acquired, 1);
+    return l;
+  }
+
+  void yieldToReaders() {
+    if (!options_.reader_priority ||
+        waiting_readers_.load(std::memory_order_relaxed) == 0) {
+      return;
+    }
+    reader_yields_.fetch_add(1, std::memory_order_relaxed);
+    auto deadline =
+        std::chrono::steady_clock::now() + options_.reader_priority_max_wait;
+    while (waiting_readers_.load(std::memory_order_relaxed) != 0 &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::yield();
+    }
+  }
+
+  // Ожидание shared-блокировки до deadline: try_lock_shared_until, если
+  // Lock его поддерживает, иначе повторные try_lock_shared с уступкой
+  // процессора.
+  template <typename DeadlineClock, typename Duration>
+  std::shared_lock<Lock> readLockUntil(
+      std::chrono::time_point<DeadlineClock, Duration> deadline) const {
+    KV_TRACE1(lock_acquire, 0);
+    std::shared_lock l(mutex_, std::defer_lock);
+    if (options_.reader_priority) {
+      waiting_readers_.fetch_add(1, std::memory_order_relaxed);
+    }
+    if constexpr (requires { mutex_.try_lock_shared_until(deadline); }) {
+      l.try_lock_until(deadline);
+    } else {
+      while (!l.try_lock() && DeadlineClock::now() < deadline) {
+        std::this_thread::yield();
+      }
+    }
+    if (options_.reader_priority) {
+      waiting_readers_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    if (!l.owns_lock()) {
+      read_timeouts_.fetch_add(1, std::memory_order_relaxed);
+      KV_TRACE(read_timeout);
+    } else {
+      KV_TRACE1(lock_acquired, 0);
+    }
+    return l;
+  }
+
+  std::optional<std::string> getLocked(const Space &space,
+                                       std::string_view key) const {
+    if (recorder_) {
+      recorder_->record(key);
+    }
+    trackHotKey(key, kv_hot::Access::Read);
+    return readRecord(space, space.records.find(std::string(key)),
+                      clock_.nowTick());
+  }
+
+  // Учитывает get найденной (или end) записи и возвращает её значение.
+  std::optional<std::string>
+  readRecord(const Space &space, typename RecordMap::const_iterator it,
+             uint64_t now) const {
+    auto &shard = space.counters.reads[readShard()];
+    shard.gets.fetch_add(1, std::memory_order_relaxed);
+    if (it == end(space.records)) {
+      return std::nullopt;
+    }
+    auto &record = it->second;
+    if (record.expiry <= now) {
+      return std::nullopt;
+    }
+    touch(record, now);
+    shard.hits.fetch_add(1, std::memory_order_relaxed);
+    return valueOf(record);
+  }
+
+  // getMany под уже взятой блокировкой.
+  std::vector<std::optional<std::string>>
+  getManyLocked(const Space &space,
+                std::span<const std::string_view> keys) const {
+    size_t group = std::max<size_t>(options_.prefetch_group, 1);
+    auto now = clock_.nowTick();
+    if (options_.coroutine_lookups && kv_tree::kSteppable) {
+      for (auto key : keys) {
+        if (recorder_) {
+          recorder_->record(key);
+        }
+        trackHotKey(key, kv_hot::Access::Read);
+      }
+      std::vector<std::optional<std::string>> result(keys.size());
+      kv_tree::interleavedFind(space.records, keys, group, &valueOf,
+                               [&](size_t i, auto it) {
+                                 result[i] = readRecord(space, it, now);
+                               });
+      return result;
+    }
+
+    std::vector<std::optional<std::string>> result;
+    result.reserve(keys.size());
+    std::vector<kv_tree::FindCursor<RecordMap>> cursors;
+    cursors.reserve(std::min(group, keys.size()));
+    for (size_t base = 0; base < keys.size(); base += group) {
+      auto batch = keys.subspan(base, std::min(group, keys.size() - base));
+      cursors.clear();
+      for (auto key : batch) {
+        cursors.emplace_back(space.records, key);
+      }
+      for (bool active = kv_tree::kSteppable; active;) {
+        active = false;
+        for (auto &cursor : cursors) {
+          if (!cursor.done()) {
+            kv_tree::prefetch(cursor.step());
+            active = true;
+          }
+        }
+      }
+      // Буферы значений длиннее SSO - ещё по промаху на ключ.
+      for (auto &cursor : cursors) {
+        if (auto it = cursor.result(); it != end(space.records)) {
+          kv_tree::prefetch(valueOf(it->second).data());
+        }
+      }
+      for (size_t i = 0; i < batch.size(); ++i) {
+        if (recorder_) {
+          recorder_->record(batch[i]);
+        }
+        trackHotKey(batch[i], kv_hot::Access::Read);
+        result.push_back(readRecord(space, cursors[i].result(), now));
+      }
+    }
+    return result;
+  }
+
+  // Собирает до count живых записей после key. Каждые scan_chunk_size
+  // просмотренных записей вызывает relock(l), который отпускает блокировку
+  // и берёт её снова, чтобы длинный обход не держал писателей. relock
+  // возвращает false, если обход нужно прервать; тогда в *stopped_after
+  // записывается последний просмотренный ключ. Итераторы std::map
+  // переживают вставки, поэтому если в пространстве ничего не удалялось
+  // (erase_version не изменился), обход продолжается с того же итератора,
+  // иначе позиция ищется заново по ключу следующей записи. Итератор ahead
+  // идёт на prefetch_group записей впереди и подгружает буферы их ключей
+  // и значений.
+  template <typename Relock>
+  std::vector<std::pair<std::string, std::string>>
+  scanSorted(Namespace ns, std::string_view key, uint32_t count,
+             std::shared_lock<Lock> &l, Relock relock,
+             std::string *stopped_after = nullptr) const {
+    std::vector<std::pair<std::string, std::string>> result;
+    const auto &space = spaceOf(ns);
+    auto it = space.records.upper_bound(std::string(key));
+    auto now = clock_.nowTick();
+    size_t chunk = options_.scan_chunk_size;
+    size_t visited = 0;
+    auto ahead = it;
+    auto prefetchAhead = [&](size_t distance) {
+      for (; distance != 0 && ahead != end(space.records); --distance) {
+        kv_tree::prefetch(ahead->first.data());
+        kv_tree::prefetch(valueOf(ahead->second).data());
+        ++ahead;
+      }
+    };
+    prefetchAhead(std::min<size_t>(options_.prefetch_group, count));
+
+    while (it != end(space.records) && result.size() < count) {
+      prefetchAhead(options_.prefetch_group != 0 ? 1 : 0);
+      if (it->second.expiry > now) {
+        result.emplace_back(it->first, valueOf(it->second));
+      }
+      ++it;
+      if (chunk != 0 && ++visited == chunk && it != end(space.records)) {
+        visited = 0;
+        auto version = space.erase_version;
+        std::string resume = it->first;
+        std::string last;
+        if (stopped_after) {
+          last = std::prev(it)->first;
+        }
+        if (!relock(l)) {
+          if (stopped_after) {
+            *stopped_after = std::move(last);
+          }
+          break;
+        }
+        if (space.erase_version != version) {
+          it = space.records.lower_bound(resume);
+          ahead = it;
+          prefetchAhead(options_.prefetch_group);
+        }
+        now = clock_.nowTick();
+      }
+    }
+    return result;
+  }
+
+  // Пространство по дескриптору, под блокировкой: spaces_ может
+  // перевыделяться. Дескриптор с чужим id (например, от другого
+  // хранилища) - std::out_of_range, а не выход за границы spaces_.
+  Space &spaceOf(Namespace ns) const {
+    if (ns.id >= spaces_.size()) {
+      throw std::out_of_range("KVStorage: unknown namespace id " +
+                              std::to_string(ns.id));
+    }
+    return *spaces_[ns.id];
+  }
+
+  static const std::string *sharedValue(const Record &record) {
+    const std::string *shared;
+    std::memcpy(&shared, record.value.data(), sizeof(shared));
+    return shared;
+  }
+
+  static const std::string &valueOf(const Record &record) {
+    return record.interned ? *sharedValue(record) : record.value;
+  }
+
+  static size_t recordBytes(std::string_view key, std::string_view value) {
+    return key.size() + value.size() + kRecordOverhead;
+  }
+
+  uint64_t nowMillis() const {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            typename Clock::duration(clock_.nowTick()))
+            .count());
+  }
+
+  // Часы читаются только для выбранных обращений.
+  void trackHotKey(std::string_view key, kv_hot::Access access) const {
+    if (hot_keys_ && hot_keys_->sample()) {
+      hot_keys_->add(key, access, nowMillis());
+    }
+  }
+
+  // Ожидание блокировки отсчитывается от создания таймера, поэтому
+  // yieldToReaders у писателей попадает в lock_wait.
+  kv_slowlog::OpTimer opTimer(std::string_view key) const {
+    return kv_slowlog::OpTimer(slowlog_ || latencies_, key);
+  }
+
+  void finishOp(kv_slowlog::OpTimer &timer, kv_slowlog::Operation operation,
+                uint32_t count) const {
+    timer.stop();
+    if (latencies_) {
+      (*latencies_)[static_cast<size_t>(operation)].record(timer.elapsed());
+    }
+    if (slowlog_) {
+      slowlog_->finish(timer, operation, count);
+    }
+  }
+
+  static uint32_t accessTime(uint64_t tick) {
+    return static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            typename Clock::duration(tick))
+            .count());
+  }
+
+  // Запись только при смене значения, чтобы горячие ключи не гоняли
+  // кэш-линию между читателями чаще раза в миллисекунду.
+  void touch(const Record &record, uint64_t now) const {
+    std::atomic_ref<uint32_t> last_access(record.last_access);
+    auto access = accessTime(now);
+    if (last_access.load(std::memory_order_relaxed) != access) {
+      last_access.store(access, std::memory_order_relaxed);
+    }
+  }
+
+  // Пространство имён с самой ранней истёкшей записью или nullptr.
+  Space *earliestExpiring(uint64_t now) {
+    Space *earliest = nullptr;
+    for (auto &space : spaces_) {
+      if (space->expiry_queue.empty()) {
+        continue;
+      }
+      auto expiry = begin(space->expiry_queue)->expiry;
+      if (expiry <= now &&
+          (!earliest || expiry < begin(earliest->expiry_queue)->expiry)) {
+        earliest = space.get();
+      }
+    }
+    return earliest;
+  }
+
+  std::unique_ptr<Space> newSpace(std::string name, NamespaceOptions options) {
+    auto space =
+        std::make_unique<Space>(std::move(name), options, huge_pages_.get());
+    if (options_.distribution_stats) {
+      space->distribution = std::make_unique<kv_sketch::Distribution>(
+          options_.prefix_delimiter, options_.max_prefixes);
+    }
+    return space;
+  }
+
+  // Секунда истечения для Distribution; пусто у записей без срока.
+  // Округляется вверх, а текущая секунда в distributionStats - вниз:
+  // живая запись всегда попадает в корзину не меньше 1 с.
+  static std::optional<uint64_t> expirySecond(uint64_t expiry) {
+    if (expiry == kNoExpiry) {
+      return std::nullopt;
+    }
+    return static_cast<uint64_t>(
+        std::chrono::ceil<std::chrono::seconds>(
+            typename Clock::duration(expiry))
+            .count());
+  }
+
+  std::pmr::memory_resource *upstreamResource() const {
+    if (huge_pages_) {
+      return huge_pages_.get();
+    }
+    return std::pmr::get_default_resource();
+  }
+
+  // Удаляет запись, первую в очереди истечения space и истёкшую к now.
+  void expireFirst(Space &space, [[maybe_unused]] uint64_t now,
+                   std::pair<std::string, std::string> *removed = nullptr) {
+    auto &first = *begin(space.expiry_queue);
+    KV_TRACE4(expire, space.name.c_str(), first.key.data(), first.key.size(),
+              std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  typename Clock::duration(now - first.expiry))
+                  .count());
+    eraseRecord(space, space.records.find(first.key), removed);
+    space.counters.expirations.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // removed, если задан, получает ключ и значение удалённой записи: их
+  // можно забрать только после учёта размера.
+  void eraseRecord(Space &space, typename RecordMap::iterator it,
+                   std::pair<std::string, std::string> *removed = nullptr) {
+    if (it->second.expiry != kNoExpiry) {
+      unqueueExpiry(space, it->second.expiry, it->first);
+    }
+    if (space.evictionEnabled()) {
+      auto slot = it->second.slot;
+      space.slots[slot] = space.slots.back();
+      space.slots[slot]->second.slot = slot;
+      space.slots.pop_back();
+    }
+    space.bytes -= recordBytes(it->first, valueOf(it->second));
+    if (space.distribution) {
+      space.distribution->remove(it->first, valueOf(it->second).size(),
+                                 expirySecond(it->second.expiry));
+    }
+    if (removed) {
+      removed->first = it->first;
+      removed->second = it->second.interned ? valueOf(it->second)
+                                            : std::move(it->second.value);
+    }
+    if (it->second.interned) {
+      interned_.release(sharedValue(it->second));
+    }
+    space.records.erase(it);
+    ++space.erase_version;
+    publishSize(space);
+  }
+
+  // Вытесняет одну запись из eviction_samples случайных, кроме keep:
+  // истёкшую, если такая попалась, иначе с самым старым last_access.
+  void evictOne(Space &space, uint64_t now, const Record *keep) {
+    std::uniform_int_distribution<size_t> dist(0, space.slots.size() - 1);
+    auto access = accessTime(now);
+    std::optional<typename RecordMap::iterator> victim;
+    uint32_t victim_age = 0;
+    uint32_t samples = std::max(options_.eviction_samples, 1u);
+    for (uint32_t i = 0; i < samples || !victim; ++i) {
+      auto candidate = space.slots[dist(rng_)];
+      if (&candidate->second == keep) {
+        continue;
+      }
+      if (candidate->second.expiry <= now) {
+        victim = candidate;
+        break;
+      }
+      uint32_t age = access - std::atomic_ref<uint32_t>(
+                                  candidate->second.last_access)
+                                  .load(std::memory_order_relaxed);
+      if (!victim || age > victim_age) {
+        victim = candidate;
+        victim_age = age;
+      }
+    }
+    eraseRecord(space, *victim);
+    space.counters.evictions.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  typename Clock::duration jitter() {
+    if (options_.expiry_jitter <= options_.expiry_jitter.zero()) {
+      return Clock::duration::zero();
+    }
+    auto window =
+        std::chrono::ceil<typename Clock::duration>(options_.expiry_jitter);
+    std::uniform_int_distribution<typename Clock::duration::rep> dist(
+        0, window.count() - 1);
+    return typename Clock::duration(dist(rng_));
+  }
+
+  // Токен-бакет для удаления истёкших записей: пополняется со скоростью
+  // max_expirations_per_second, вмещает не больше одной секунды работы.
+  size_t takeExpirationTokens(uint64_t now, size_t wanted) {
+    double rate = options_.max_expirations_per_second;
+    if (rate == 0) {
+      return wanted;
+    }
+    if (now > last_refill_) {
+      double elapsed = std::chrono::duration<double>(
+                           typename Clock::duration(now - last_refill_))
+                           .count();
+      expiration_tokens_ = std::min(rate, expiration_tokens_ + elapsed * rate);
+      last_refill_ = now;
+    }
+    auto granted = std::min(wanted, static_cast<size_t>(expiration_tokens_));
+    expiration_tokens_ -= static_cast<double>(granted);
+    return granted;
+  }
+
+  // Возвращает ключ в индексе: key перемещается туда.
+  const std::string &setLocked(Space &space, std::string key,
+                               std::string value, uint64_t expiry) {
+    trackHotKey(key, kv_hot::Access::Write);
+    auto now = clock_.nowTick();
+    auto [it, inserted] = space.records.try_emplace(std::move(key));
+    auto &record = it->second;
+    if (!inserted) {
+      if (record.expiry != kNoExpiry) {
+        unqueueExpiry(space, record.expiry, it->first);
+      }
+      space.bytes -= recordBytes(it->first, valueOf(record));
+      if (space.distribution) {
+        space.distribution->remove(it->first, valueOf(record).size(),
+                                   expirySecond(record.expiry));
+      }
+      if (record.interned) {
+        interned_.release(sharedValue(record));
+      }
+    }
+    record.interned = value.size() > kInlineValueSize &&
+                      value.size() <= options_.intern_max_value_size;
+    if (record.interned) {
+      auto *shared = interned_.acquire(std::move(value));
+      // swap, а не assign: старый буфер значения в куче освобождается.
+      std::string(reinterpret_cast<const char *>(&shared), sizeof(shared))
+          .swap(record.value);
+    } else {
+      record.value = std::move(value);
+    }
+    record.expiry = expiry;
+    record.last_access = accessTime(now);
+    space.bytes += recordBytes(it->first, valueOf(record));
+    if (space.distribution) {
+      space.distribution->add(it->first, valueOf(record).size(),
+                              expirySecond(expiry));
+    }
+    space.counters.sets.fetch_add(1, std::memory_order_relaxed);
+    if (expiry != kNoExpiry) {
+      queueExpiry(space, expiry, it->first,
+                  recordBytes(it->first, valueOf(record)));
+    }
+    if (space.evictionEnabled()) {
+      if (inserted) {
+        record.slot = static_cast<uint32_t>(space.slots.size());
+        space.slots.push_back(it);
+      }
+      while (space.overQuota() && space.records.size() > 1) {
+        evictOne(space, now, &record);
+      }
+    }
+    publishSize(space);
+    return it->first;
+  }
+
+  static void queueExpiry(Space &space, uint64_t expiry,
+                          const std::string &key, size_t bytes) {
+    auto it = space.expiry_queue.insert({expiry, key, bytes}).first;
+    if (expiry <= space.expired_until) {
+      ++space.expired_records;
+      space.expired_bytes += bytes;
+      publishBacklog(space);
+    } else if (space.frontier == end(space.expiry_queue) ||
+               *it < *space.frontier) {
+      space.frontier = it;
+    }
+  }
+
+  static void unqueueExpiry(Space &space, uint64_t expiry,
+                            const std::string &key) {
+    auto it = space.expiry_queue.find({expiry, key});
+    if (expiry <= space.expired_until) {
+      --space.expired_records;
+      space.expired_bytes -= it->bytes;
+      publishBacklog(space);
+    } else if (it == space.frontier) {
+      ++space.frontier;
+    }
+    space.expiry_queue.erase(it);
+  }
+
+  // Сдвигает границу истёкших к now: амортизированно O(1) на запрос.
+  static void advanceBacklog(Space &space, uint64_t now) {
+    std::lock_guard l(space.frontier_mutex);
+    if (now <= space.expired_until) {
+      return;
+    }
+    for (auto &f = space.frontier;
+         f != end(space.expiry_queue) && f->expiry <= now; ++f) {
+      ++space.expired_records;
+      space.expired_bytes += f->bytes;
+    }
+    space.expired_until = now;
+    publishBacklog(space);
+  }
+
+  static void publishBacklog(Space &space) {
+    space.counters.expired.store(space.expired_records,
+                                 std::memory_order_relaxed);
+    space.counters.expired_bytes.store(space.expired_bytes,
+                                       std::memory_order_relaxed);
+  }
+
+  static void publishSize(Space &space) {
+    space.counters.records.store(space.records.size(),
+                                 std::memory_order_relaxed);
+    space.counters.bytes.store(space.bytes, std::memory_order_relaxed);
+  }
+
+  mutable Lock mutex_;
+  // Объявлен раньше spaces_: пулы пространств возвращают в него память.
+  std::unique_ptr<kv_memory::HugePageResource> huge_pages_;
+  // spaces_[0] - пространство имён по умолчанию.
+  std::vector<std::unique_ptr<Space>> spaces_;
+  // spaces_[0] для metrics(): сам вектор без блокировки не читается, а
+  // Space не перемещается, пока вектор перевыделяется.
+  const Space *default_space_ = nullptr;
+  std::map<std::string, Namespace, std::less<>> namespace_ids_;
+  kv_common::TickClock<Clock> clock_;
+  KVStorageOptions options_;
+  std::minstd_rand rng_{std::random_device{}()};
+  double expiration_tokens_;
+  uint64_t last_refill_;
+
+  kv_admission::TokenBucket write_bucket_;
+  kv_admission::TokenBucket write_bytes_bucket_;
+  mutable std::atomic<uint32_t> waiting_readers_{0};
+  std::atomic<uint64_t> admitted_{0};
+  std::atomic<uint64_t> rejected_{0};
+  std::atomic<uint64_t> delayed_{0};
+  std::atomic<uint64_t> delay_ns_{0};
+  std::atomic<uint64_t> reader_yields_{0};
+  mutable std::atomic<uint64_t> read_timeouts_{0};
+  std::unique_ptr<kv_access::AccessRecorder> recorder_;
+  kv_intern::ValueTable interned_;
+  std::unique_ptr<kv_hot::HotKeyTracker> hot_keys_;
+  std::unique_ptr<kv_slowlog::SlowLog> slowlog_;
+  std::unique_ptr<std::array<kv_metrics::LatencyHistogram,
+                             kv_slowlog::kOperations>>
+      latencies_;
 };
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Состояние потока, своё у каждого объекта-владельца (счётчики выборки
+// kv_access::AccessRecorder и kv_hot::HotKeyTracker).
+namespace kv_thread {
+
+// Поток хранит State для kOwners последних владельцев, с которыми
+// работал, чтобы обращения попеременно к нескольким хранилищам не
+// сбрасывали их счётчики. Найденное состояние переносится в начало, новое
+// вытесняет самое давнее. Владелец узнаётся по номеру, а не по адресу:
+// объект по адресу удалённого не должен унаследовать его состояние.
+template <typename State, size_t kOwners = 4> class PerThreadState {
+public:
+  PerThreadState() : id_(nextId()) {}
+  PerThreadState(const PerThreadState &) = delete;
+  PerThreadState &operator=(const PerThreadState &) = delete;
+
+  // Состояние текущего потока; если его нет, оно создаётся init().
+  template <typename Init> State &get(Init init) const {
+    auto &slots = threadSlots();
+    auto found = std::find_if(slots.begin(), slots.end(),
+                              [&](auto &slot) { return slot.owner == id_; });
+    if (found == slots.end()) {
+      --found;
+      *found = {id_, init()};
+    }
+    std::rotate(slots.begin(), found, found + 1);
+    return slots.front().state;
+  }
+
+private:
+  struct Slot {
+    uint64_t owner = 0;
+    State state{};
+  };
+
+  static std::array<Slot, kOwners> &threadSlots() {
+    static thread_local std::array<Slot, kOwners> slots;
+    return slots;
+  }
+
+  static uint64_t nextId() {
+    static std::atomic<uint64_t> next{1};
+    return next.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  uint64_t id_;
+};
+
+} // namespace kv_thread
@@ -0,0 +1,29 @@
+#pragma once
+
+// Статические точки трассировки USDT (провайдер kv_storage) для bpftrace,
+// perf и SystemTap; примеры скриптов - tools/*.bt. Если есть <sys/sdt.h>
+// (пакет systemtap-sdt-dev), точка - одна инструкция nop и запись в
+// секции .note.stapsdt; аргументы вычисляются, даже когда к точке никто
+// не подключён. Без заголовка или с KV_STORAGE_NO_USDT макросы ничего не
+// вычисляют.
+#if !defined(KV_STORAGE_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define KV_TRACE_HAS_USDT 1
+#include <sys/sdt.h>
+#endif
+#endif
+
+#ifdef KV_TRACE_HAS_USDT
+#define KV_TRACE(probe) DTRACE_PROBE(kv_storage, probe)
+#define KV_TRACE1(probe, a) DTRACE_PROBE1(kv_storage, probe, a)
+#define KV_TRACE2(probe, a, b) DTRACE_PROBE2(kv_storage, probe, a, b)
+#define KV_TRACE3(probe, a, b, c) DTRACE_PROBE3(kv_storage, probe, a, b, c)
+#define KV_TRACE4(probe, a, b, c, d)                                          \
+  DTRACE_PROBE4(kv_storage, probe, a, b, c, d)
+#else
+#define KV_TRACE(probe) ((void)0)
+#define KV_TRACE1(probe, a) ((void)0)
+#define KV_TRACE2(probe, a, b) ((void)0)
+#define KV_TRACE3(probe, a, b, c) ((void)0)
+#define KV_TRACE4(probe, a, b, c, d) ((void)0)
+#endif
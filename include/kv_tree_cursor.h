@@ -0,0 +1,180 @@
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <map>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Пошаговый поиск ключа в std::map<std::string, T> для getMany: поиски
+// нескольких ключей идут вперемешку по одному уровню дерева, и промах
+// кэша на узле одного ключа перекрывается с шагами остальных. Чередуются
+// либо группы курсоров FindCursor, либо корутины interleavedFind.
+namespace kv_tree {
+
+inline void prefetch(const void *address) {
+#if defined(__GNUC__)
+  if (address) {
+    __builtin_prefetch(address);
+  }
+#else
+  (void)address;
+#endif
+}
+
+#if defined(__GLIBCXX__)
+
+// Узлы libstdc++ (_Rb_tree_node_base) доступны через открытое поле
+// _M_node итератора; по ним поиск проходит по уровню за вызов step().
+inline constexpr bool kSteppable = true;
+
+template <typename Map> class FindCursor {
+public:
+  using Node = std::_Rb_tree_node<typename Map::value_type>;
+  using Base = const std::_Rb_tree_node_base *;
+
+  FindCursor(const Map &map, std::string_view key)
+      : key_(key), header_(map.end()._M_node), best_(header_),
+        node_(header_->_M_parent) {}
+
+  bool done() const { return node_ == nullptr; }
+
+  // Спускается на уровень ниже и возвращает следующий узел (для
+  // prefetch) или nullptr, если поиск закончен.
+  const void *step() {
+    if (std::string_view(keyOf(node_)) < key_) {
+      node_ = node_->_M_right;
+    } else {
+      best_ = node_;
+      node_ = node_->_M_left;
+    }
+    return node_;
+  }
+
+  // То же, что map.find(key); вызывается после done().
+  typename Map::const_iterator result() const {
+    if (best_ == header_ || key_ < std::string_view(keyOf(best_))) {
+      return typename Map::const_iterator(header_);
+    }
+    return typename Map::const_iterator(best_);
+  }
+
+private:
+  static const std::string &keyOf(Base node) {
+    return static_cast<const Node *>(node)->_M_valptr()->first;
+  }
+
+  std::string_view key_;
+  Base header_;
+  Base best_;
+  Base node_;
+};
+
+#else
+
+// Без доступа к узлам поиск выполняется целиком при создании курсора.
+inline constexpr bool kSteppable = false;
+
+template <typename Map> class FindCursor {
+public:
+  FindCursor(const Map &map, std::string_view key)
+      : result_(map.find(std::string(key))) {}
+
+  bool done() const { return true; }
+  const void *step() { return nullptr; }
+  typename Map::const_iterator result() const { return result_; }
+
+private:
+  typename Map::const_iterator result_;
+};
+
+#endif
+
+// Корутина-дорожка interleavedFind. Запускается приостановленной;
+// планировщик возобновляет её до следующей точки co_await.
+class LookupTask {
+public:
+  struct promise_type {
+    LookupTask get_return_object() {
+      return LookupTask(
+          std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+
+  LookupTask(LookupTask &&other) noexcept
+      : handle_(std::exchange(other.handle_, nullptr)) {}
+  LookupTask &operator=(LookupTask &&) = delete;
+
+  ~LookupTask() {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+  bool done() const { return handle_.done(); }
+  void resume() { handle_.resume(); }
+
+private:
+  explicit LookupTask(std::coroutine_handle<promise_type> handle)
+      : handle_(handle) {}
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+// Дорожка берёт очередной ключ из keys по счётчику next, после каждого
+// шага поиска подгружает следующий узел и уступает очередь другим
+// дорожкам; у найденной записи так же подгружает буфер значения, который
+// возвращает value(it->second). visit(i, it) вызывается с индексом ключа
+// и результатом find.
+template <typename Map, typename Value, typename Visit>
+LookupTask findLane(const Map &map, std::span<const std::string_view> keys,
+                    size_t &next, Value &value, Visit &visit) {
+  for (size_t i; (i = next++) < keys.size();) {
+    FindCursor<Map> cursor(map, keys[i]);
+    while (!cursor.done()) {
+      prefetch(cursor.step());
+      co_await std::suspend_always{};
+    }
+    auto it = cursor.result();
+    if (it != map.end()) {
+      prefetch(value(it->second).data());
+      co_await std::suspend_always{};
+    }
+    visit(i, it);
+  }
+}
+
+// Ищет keys в map дорожками по lanes штук, которые планировщик
+// возобновляет по кругу. В отличие от групп фиксированного размера,
+// освободившаяся дорожка сразу берёт следующий ключ, поэтому в полёте
+// всё время lanes промахов. Порядок вызовов visit не совпадает с
+// порядком keys.
+template <typename Map, typename Value, typename Visit>
+void interleavedFind(const Map &map, std::span<const std::string_view> keys,
+                     size_t lanes, Value value, Visit visit) {
+  size_t next = 0;
+  std::vector<LookupTask> tasks;
+  tasks.reserve(lanes);
+  for (size_t i = 0; i < lanes && i < keys.size(); ++i) {
+    tasks.push_back(findLane(map, keys, next, value, visit));
+  }
+  for (bool active = true; active;) {
+    active = false;
+    for (auto &task : tasks) {
+      if (!task.done()) {
+        task.resume();
+        active = true;
+      }
+    }
+  }
+}
+
+} // namespace kv_tree
@@ -0,0 +1,150 @@
+#include "kv_cuckoo_storage.h"
+#include <atomic>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+using namespace std::chrono_literals;
+
+namespace {
+
+class CuckooTestClock {
+public:
+  using time_point = steady_clock::time_point;
+  using duration = steady_clock::duration;
+
+  static time_point now() noexcept { return current_time; }
+  static void advance(duration d) { current_time += d; }
+
+private:
+  static inline time_point current_time{};
+};
+
+} // namespace
+
+TEST(KVCuckooStorageTest, SetGetRemove) {
+  vector<tuple<string, string, uint32_t>> entries = {{"k1", "v1", 0},
+                                                     {"k2", "v2", 10}};
+  KVCuckooStorage<CuckooTestClock> storage(entries);
+  EXPECT_EQ(storage.get("k1"), "v1");
+  EXPECT_EQ(storage.get("k2"), "v2");
+  storage.set("k1", "v3");
+  EXPECT_EQ(storage.get("k1"), "v3");
+  EXPECT_TRUE(storage.remove("k1"));
+  EXPECT_FALSE(storage.remove("k1"));
+  EXPECT_FALSE(storage.get("k1").has_value());
+  EXPECT_EQ(storage.size(), 1);
+}
+
+TEST(KVCuckooStorageTest, HighLoadFactor) {
+  KVCuckooStorage<CuckooTestClock> storage({});
+  size_t min_buckets = 0;
+  double max_load = 0;
+  for (int i = 0; i < 30000; ++i) {
+    auto buckets = storage.bucketCount();
+    storage.set("key" + to_string(i), to_string(i));
+    // Перед ростом таблица заполняется почти полностью
+    if (storage.bucketCount() != buckets && buckets >= 512) {
+      max_load = max(max_load, static_cast<double>(i) / (buckets * 4));
+    }
+    min_buckets = storage.bucketCount();
+  }
+  EXPECT_GT(max_load, 0.9);
+  EXPECT_GE(min_buckets * 4, 30000);
+  for (int i = 0; i < 30000; ++i) {
+    ASSERT_EQ(storage.get("key" + to_string(i)), to_string(i));
+  }
+  for (int i = 0; i < 30000; i += 2) {
+    ASSERT_TRUE(storage.remove("key" + to_string(i)));
+  }
+  EXPECT_EQ(storage.size(), 15000);
+  EXPECT_FALSE(storage.get("key0").has_value());
+  EXPECT_EQ(storage.get("key1"), "1");
+}
+
+TEST(KVCuckooStorageTest, Expiry) {
+  KVCuckooStorage<CuckooTestClock> storage({});
+  storage.set("late", "v", 5);
+  storage.set("early", "v", 2);
+  storage.set("forever", "v");
+  storage.set("renewed", "v", 1);
+  storage.set("renewed", "v", 0);
+
+  CuckooTestClock::advance(3s);
+  EXPECT_FALSE(storage.get("early").has_value());
+  EXPECT_EQ(storage.get("late"), "v");
+  EXPECT_EQ(storage.get("renewed"), "v");
+  EXPECT_EQ(storage.removeOneExpiredEntry()->first, "early");
+  EXPECT_FALSE(storage.removeOneExpiredEntry().has_value());
+  EXPECT_EQ(storage.size(), 3);
+  EXPECT_EQ(storage.getManySorted("", 10).size(), 3);
+}
+
+TEST(KVCuckooStorageTest, OptimisticReadersSeeEveryKey) {
+  // Писатель вставляет новые ключи (с вытеснениями и ростом таблицы) и
+  // перезаписывает старые; ключи из первой половины всегда должны
+  // находиться.
+  KVCuckooStorage<> storage({});
+  for (int i = 0; i < 1000; ++i) {
+    storage.set("stable" + to_string(i), "v");
+  }
+  atomic<bool> stop{false};
+  atomic<int> misses{0};
+  vector<thread> readers;
+  for (int r = 0; r < 3; ++r) {
+    readers.emplace_back([&, r] {
+      for (int i = r; !stop; i = (i + 7) % 1000) {
+        if (!storage.get("stable" + to_string(i))) {
+          ++misses;
+        }
+      }
+    });
+  }
+  for (int i = 0; i < 50000; ++i) {
+    storage.set("new" + to_string(i), "v");
+    storage.set("stable" + to_string(i % 1000), to_string(i));
+  }
+  stop = true;
+  for (auto &t : readers) {
+    t.join();
+  }
+  EXPECT_EQ(misses, 0);
+  EXPECT_EQ(storage.size(), 51000);
+}
+
+TEST(KVCuckooStorageTest, ReadersNeverSeeReclaimedEntries) {
+  // Перезаписи снимают записи сотнями, в том числе большие (из кучи), а
+  // память снятых идёт под новые: читатель не должен увидеть значение,
+  // поверх которого уже пишется другое.
+  KVCuckooStorage<> storage({});
+  storage.set("key", "a");
+  atomic<bool> stop{false};
+  atomic<int> torn{0};
+  vector<thread> readers;
+  for (int r = 0; r < 3; ++r) {
+    readers.emplace_back([&] {
+      while (!stop) {
+        auto value = storage.get("key");
+        if (!value || value->empty() ||
+            value->find_first_not_of(value->front()) != string::npos) {
+          ++torn;
+        }
+      }
+    });
+  }
+  for (int i = 0; i < 100000; ++i) {
+    storage.set("key", string(1 + i % 700, static_cast<char>('a' + i % 26)));
+    storage.set("other" + to_string(i % 100), "v");
+  }
+  stop = true;
+  for (auto &t : readers) {
+    t.join();
+  }
+  EXPECT_EQ(torn, 0);
+  EXPECT_EQ(storage.size(), 101);
+}
@@ -0,0 +1,116 @@
+#include "kv_direct_io.h"
+#include "kv_format.h"
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class KVDirectIoTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    path_ = ::testing::TempDir() + "kv_direct_io_" +
+            ::testing::UnitTest::GetInstance()->current_test_info()->name();
+  }
+  void TearDown() override { std::remove(path_.c_str()); }
+
+  string path_;
+};
+
+TEST_F(KVDirectIoTest, BufferPoolReusesBuffers) {
+  kv_io::AlignedBufferPool pool(5000);
+  EXPECT_EQ(pool.bufferSize() % kv_io::kDirectIoAlignment, 0);
+  char *first = nullptr;
+  {
+    auto buffer = pool.acquire();
+    first = buffer.get();
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(first) % pool.alignment(), 0);
+  }
+  EXPECT_EQ(pool.freeBuffers(), 1);
+  auto again = pool.acquire();
+  EXPECT_EQ(again.get(), first);
+}
+
+TEST_F(KVDirectIoTest, WriteAndReadBackUnalignedSize) {
+  kv_io::AlignedBufferPool pool(8192);
+  string data;
+  for (int i = 0; i < 30000; ++i) {
+    data.push_back(static_cast<char>('a' + i % 26));
+  }
+
+  for (auto mode : {kv_io::IoMode::Direct, kv_io::IoMode::Buffered}) {
+    kv_io::DirectFileWriter writer(pool, 2);
+    ASSERT_FALSE(writer.open(path_, mode));
+    if (mode == kv_io::IoMode::Buffered) {
+      EXPECT_FALSE(writer.direct());
+    }
+    // Кусками разного размера, чтобы пересекать границы буферов
+    for (size_t pos = 0; pos < data.size(); pos += 777) {
+      writer.append(string_view(data).substr(pos, 777));
+    }
+    EXPECT_FALSE(writer.flush());
+    EXPECT_FALSE(writer.close(true));
+
+    string read_back;
+    ASSERT_FALSE(kv_io::readFile(path_, read_back, pool, mode));
+    EXPECT_EQ(read_back, data);
+  }
+}
+
+TEST_F(KVDirectIoTest, FormatBlocksSurviveDirectWrite) {
+  kv_io::AlignedBufferPool pool;
+  string encoded;
+  kv_format::appendFileHeader(encoded);
+  kv_format::BlockBuilder builder;
+  builder.add("key", "value", 0, 1);
+  builder.finish(encoded);
+
+  kv_io::DirectFileWriter writer(pool);
+  ASSERT_FALSE(writer.open(path_));
+  writer.append(encoded);
+  ASSERT_FALSE(writer.close());
+
+  string file;
+  ASSERT_FALSE(kv_io::readFile(path_, file, pool));
+  size_t offset = 0;
+  vector<kv_format::RecordView> records;
+  ASSERT_EQ(kv_format::readFileHeader(file, offset), kv_format::Status::Ok);
+  ASSERT_EQ(kv_format::readBlock(file, offset, records),
+            kv_format::Status::Ok);
+  EXPECT_EQ(kv_format::readBlock(file, offset, records),
+            kv_format::Status::EndOfData);
+  ASSERT_EQ(records.size(), 1);
+  EXPECT_EQ(records[0].value, "value");
+}
+
+TEST_F(KVDirectIoTest, OpenFailureReportsError) {
+  kv_io::AlignedBufferPool pool;
+  kv_io::DirectFileWriter writer(pool);
+  EXPECT_TRUE(writer.open("/nonexistent-dir/file"));
+  EXPECT_FALSE(writer.isOpen());
+}
+
+TEST_F(KVDirectIoTest, SyncMakesTailDurableWithoutClose) {
+  kv_io::AlignedBufferPool pool(8192);
+  for (auto mode : {kv_io::IoMode::Direct, kv_io::IoMode::Buffered}) {
+    kv_io::DirectFileWriter writer(pool, 2);
+    ASSERT_FALSE(writer.open(path_, mode));
+    string data;
+    // Хвост переписывается, пока буфер не заполнится и не уйдёт целиком
+    for (int round = 0; round < 5; ++round) {
+      string record(3001 + round, static_cast<char>('a' + round));
+      writer.append(record);
+      data += record;
+      ASSERT_FALSE(writer.sync());
+
+      string read_back;
+      ASSERT_FALSE(kv_io::readFile(path_, read_back, pool, mode));
+      EXPECT_EQ(read_back, data) << "round " << round;
+    }
+    EXPECT_FALSE(writer.close());
+    string read_back;
+    ASSERT_FALSE(kv_io::readFile(path_, read_back, pool, mode));
+    EXPECT_EQ(read_back, data);
+  }
+}
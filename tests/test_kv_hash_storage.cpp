@@ -0,0 +1,119 @@
+#include "kv_hash_storage.h"
+#include <chrono>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+using namespace std::chrono_literals;
+
+namespace {
+
+class ManualClock {
+public:
+  using time_point = steady_clock::time_point;
+  using duration = steady_clock::duration;
+
+  static time_point now() noexcept { return current_time; }
+  static void advance(duration d) { current_time += d; }
+
+private:
+  static inline time_point current_time{};
+};
+
+} // namespace
+
+TEST(KVHashStorageTest, SetGetRemove) {
+  vector<tuple<string, string, uint32_t>> entries = {{"k1", "v1", 0},
+                                                     {"k2", "v2", 10}};
+  KVHashStorage<ManualClock> storage(entries);
+  EXPECT_EQ(storage.get("k1"), "v1");
+  EXPECT_EQ(storage.get("k2"), "v2");
+  storage.set("k1", "v3");
+  EXPECT_EQ(storage.get("k1"), "v3");
+  EXPECT_TRUE(storage.remove("k1"));
+  EXPECT_FALSE(storage.remove("k1"));
+  EXPECT_FALSE(storage.get("k1").has_value());
+  EXPECT_EQ(storage.size(), 1);
+}
+
+TEST(KVHashStorageTest, GrowsAndReusesDeletedSlots) {
+  // Один шард, чтобы таблица росла и чистилась от меток удаления
+  KVHashStorage<ManualClock> storage({}, ManualClock{}, 1);
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < 10000; ++i) {
+      storage.set("key" + to_string(i), to_string(i + round));
+    }
+    for (int i = 0; i < 10000; i += 2) {
+      ASSERT_TRUE(storage.remove("key" + to_string(i)));
+    }
+    EXPECT_EQ(storage.size(), 5000);
+    for (int i = 0; i < 10000; ++i) {
+      auto value = storage.get("key" + to_string(i));
+      if (i % 2 == 0) {
+        ASSERT_FALSE(value.has_value());
+      } else {
+        ASSERT_EQ(value, to_string(i + round));
+      }
+    }
+  }
+}
+
+TEST(KVHashStorageTest, Expiry) {
+  KVHashStorage<ManualClock> storage({});
+  storage.set("late", "v", 5);
+  storage.set("early", "v", 2);
+  storage.set("subsecond", "v", 100ms);
+  storage.set("forever", "v");
+  storage.set("renewed", "v", 1);
+  storage.set("renewed", "v", 0);
+
+  ManualClock::advance(3s);
+  EXPECT_FALSE(storage.get("early").has_value());
+  EXPECT_EQ(storage.get("late"), "v");
+  EXPECT_EQ(storage.get("renewed"), "v");
+
+  auto first = storage.removeOneExpiredEntry();
+  ASSERT_TRUE(first.has_value());
+  EXPECT_EQ(first->first, "subsecond");
+  EXPECT_EQ(storage.removeOneExpiredEntry()->first, "early");
+  EXPECT_FALSE(storage.removeOneExpiredEntry().has_value());
+  EXPECT_EQ(storage.size(), 3);
+}
+
+TEST(KVHashStorageTest, GetManySortedFallback) {
+  KVHashStorage<ManualClock> storage({});
+  for (int i = 9; i >= 0; --i) {
+    storage.set("key" + to_string(i), "v" + to_string(i), i == 4 ? 1 : 0);
+  }
+  ManualClock::advance(2s);
+  auto result = storage.getManySorted("key2", 3);
+  vector<pair<string, string>> expected = {
+      {"key3", "v3"}, {"key5", "v5"}, {"key6", "v6"}};
+  EXPECT_EQ(result, expected);
+  EXPECT_EQ(storage.getManySorted("key8", 10).size(), 1);
+}
+
+TEST(KVHashStorageTest, ConcurrentAccess) {
+  KVHashStorage<> storage({});
+  vector<thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < 5000; ++i) {
+        string key = "key_" + to_string(t) + "_" + to_string(i);
+        storage.set(key, "value");
+        EXPECT_EQ(storage.get(key), "value");
+        if (i % 3 == 0) {
+          EXPECT_TRUE(storage.remove(key));
+        }
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(storage.size(), 4 * 3333);
+}
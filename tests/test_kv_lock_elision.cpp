@@ -0,0 +1,101 @@
+#include "kv_lock_elision.h"
+#include "kv_storage.h"
+#include <gtest/gtest.h>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+using EmulatedLock =
+    kv_lock::ElidedSharedMutex<std::shared_mutex, kv_lock::EmulatedBackend>;
+
+TEST(KVLockElisionTest, UncontendedOperationsAreElided) {
+  EmulatedLock lock;
+  {
+    unique_lock l(lock);
+  }
+  {
+    shared_lock l(lock);
+  }
+  auto stats = lock.stats();
+  EXPECT_EQ(stats.elided, 2);
+  EXPECT_EQ(stats.aborts, 0);
+  EXPECT_EQ(stats.fallbacks, 0);
+}
+
+TEST(KVLockElisionTest, AbortsFallBackToLock) {
+  // Каждая попытка обрывается: kMaxAttempts абортов и один fallback
+  EmulatedLock lock(1);
+  {
+    unique_lock l(lock);
+    EXPECT_FALSE(lock.try_lock_shared());
+  }
+  auto stats = lock.stats();
+  EXPECT_EQ(stats.elided, 0);
+  EXPECT_EQ(stats.fallbacks, 2);
+  // Пока писатель держит fallback, читатель сразу идёт в shared_mutex
+  EXPECT_EQ(stats.aborts, EmulatedLock::kMaxAttempts);
+}
+
+TEST(KVLockElisionTest, RetriesAfterAbort) {
+  EmulatedLock lock(2); // обрывается каждая вторая попытка
+  lock.lock_shared();
+  lock.unlock_shared();
+  lock.lock();
+  lock.unlock();
+  auto stats = lock.stats();
+  EXPECT_EQ(stats.aborts, 2);
+  EXPECT_EQ(stats.elided, 2);
+  EXPECT_EQ(stats.fallbacks, 0);
+}
+
+TEST(KVLockElisionTest, HeldFallbackExcludesOthers) {
+  EmulatedLock lock(1);
+  lock.lock(); // все попытки обрываются, писатель берёт shared_mutex
+  EXPECT_FALSE(lock.try_lock_shared());
+  EXPECT_FALSE(lock.try_lock());
+  lock.unlock();
+  EXPECT_TRUE(lock.try_lock_shared());
+  lock.unlock_shared();
+}
+
+TEST(KVLockElisionTest, StorageWithElidedLock) {
+  KVStorage<chrono::steady_clock, EmulatedLock> storage({});
+  vector<thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < 1000; ++i) {
+        string key = "key_" + to_string(t) + "_" + to_string(i);
+        storage.set(key, "value");
+        EXPECT_EQ(storage.get(key), "value");
+        if (i % 3 == 0) {
+          EXPECT_TRUE(storage.remove(key));
+        }
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(storage.getManySorted("", 10000).size(), 4 * 666);
+}
+
+TEST(KVLockElisionTest, RtmLockWorksWithOrWithoutHardware) {
+  kv_lock::ElidedSharedMutex<> lock;
+  {
+    unique_lock l(lock);
+  }
+  {
+    shared_lock l(lock);
+  }
+  auto stats = lock.stats();
+  if (decltype(lock)::elisionAvailable()) {
+    EXPECT_EQ(stats.elided + stats.fallbacks, 2);
+  } else {
+    // Без TSX элизия не пытается и ничего не считает
+    EXPECT_EQ(stats.elided + stats.aborts + stats.fallbacks, 0);
+  }
+}
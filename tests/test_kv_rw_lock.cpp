@@ -0,0 +1,116 @@
+#include "kv_rw_lock.h"
+#include "kv_storage.h"
+#include <atomic>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono_literals;
+
+template <typename Lock> class KVRwLockTest : public ::testing::Test {};
+
+using LockTypes =
+    ::testing::Types<kv_lock::AdaptiveSharedMutex,
+                     kv_lock::BravoSharedMutex<>,
+                     kv_lock::BravoSharedMutex<std::shared_mutex>>;
+TYPED_TEST_SUITE(KVRwLockTest, LockTypes);
+
+TYPED_TEST(KVRwLockTest, TryLockSemantics) {
+  TypeParam lock;
+  ASSERT_TRUE(lock.try_lock());
+  EXPECT_FALSE(lock.try_lock_shared());
+  lock.unlock();
+
+  ASSERT_TRUE(lock.try_lock_shared());
+  ASSERT_TRUE(lock.try_lock_shared());
+  EXPECT_FALSE(lock.try_lock());
+  lock.unlock_shared();
+  lock.unlock_shared();
+  EXPECT_TRUE(lock.try_lock());
+  lock.unlock();
+}
+
+TYPED_TEST(KVRwLockTest, ParkedReadersEnterAfterWriterUnlocks) {
+  // Читатели успевают перейти от активного ожидания к парковке, пока
+  // писатели держат блокировку; после последнего unlock ни один не должен
+  // остаться запертым битом ожидающего писателя.
+  TypeParam lock;
+  lock.lock();
+  atomic<int> entered{0};
+  vector<thread> readers;
+  for (int r = 0; r < 4; ++r) {
+    readers.emplace_back([&] {
+      shared_lock l(lock);
+      ++entered;
+    });
+  }
+  thread writer([&] {
+    unique_lock l(lock);
+  });
+  this_thread::sleep_for(50ms);
+  EXPECT_EQ(entered, 0);
+  lock.unlock();
+  writer.join();
+  for (auto &t : readers) {
+    t.join();
+  }
+  EXPECT_EQ(entered, 4);
+  EXPECT_TRUE(lock.try_lock_shared());
+  lock.unlock_shared();
+}
+
+TYPED_TEST(KVRwLockTest, WritersAreExclusive) {
+  TypeParam lock;
+  atomic<int> active_readers{0};
+  long counter = 0;
+  atomic<bool> violation{false};
+
+  vector<thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < 5000; ++i) {
+        if ((i + t) % 4 == 0) {
+          unique_lock l(lock);
+          if (active_readers.load() != 0) {
+            violation = true;
+          }
+          ++counter; // неатомарно, под эксклюзивной блокировкой
+        } else {
+          shared_lock l(lock);
+          active_readers.fetch_add(1);
+          volatile long snapshot = counter;
+          (void)snapshot;
+          active_readers.fetch_sub(1);
+        }
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  EXPECT_FALSE(violation);
+  EXPECT_EQ(counter, 8 * 5000 / 4);
+}
+
+TYPED_TEST(KVRwLockTest, WorksAsStorageLockPolicy) {
+  KVStorage<chrono::steady_clock, TypeParam> storage({});
+  vector<thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < 1000; ++i) {
+        string key = "key_" + to_string(t) + "_" + to_string(i);
+        storage.set(key, "value");
+        EXPECT_EQ(storage.get(key), "value");
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(storage.getManySorted("", 10000).size(), 4000);
+}
@@ -1,6 +1,8 @@
 #include "kv_storage.h"
 #include <chrono>
 #include <gtest/gtest.h>
+#include <random>
+#include <shared_mutex>
 #include <string>
 #include <thread>
 #include <tuple>
@@ -348,3 +350,1354 @@ TEST_F(KVStorageTest, MixedOperations) {
     }
   }
 }
+
+// 9. Абсолютные сроки и TTL меньше секунды
+TEST_F(KVStorageTest, SubSecondTTL) {
+  KVStorage<TestClock> storage({});
+  storage.set("short", "value", 250ms);
+
+  TestClock::advance(200ms);
+  EXPECT_EQ(storage.get("short"), "value");
+
+  TestClock::advance(50ms);
+  EXPECT_FALSE(storage.get("short").has_value());
+}
+
+TEST_F(KVStorageTest, SetWithDeadline) {
+  KVStorage<TestClock> storage({});
+  storage.setWithDeadline("k", "v", TestClock::now() + 3s);
+
+  TestClock::advance(2s);
+  EXPECT_EQ(storage.get("k"), "v");
+  TestClock::advance(1s);
+  EXPECT_FALSE(storage.get("k").has_value());
+
+  auto removed = storage.removeOneExpiredEntry();
+  ASSERT_TRUE(removed.has_value());
+  EXPECT_EQ(removed->first, "k");
+  EXPECT_EQ(removed->second, "v");
+}
+
+TEST_F(KVStorageTest, SetWithDeadlineInThePast) {
+  TestClock::advance(10s);
+  KVStorage<TestClock> storage({});
+  storage.setWithDeadline("k", "v", TestClock::now() - 20s);
+  EXPECT_FALSE(storage.get("k").has_value());
+  EXPECT_TRUE(storage.removeOneExpiredEntry().has_value());
+}
+
+TEST_F(KVStorageTest, SetWithDeadlineFromOtherClock) {
+  KVStorage<TestClock> storage({});
+  storage.setWithDeadline("k", "v", steady_clock::now() + 1h);
+
+  TestClock::advance(59min);
+  EXPECT_EQ(storage.get("k"), "v");
+  TestClock::advance(2min);
+  EXPECT_FALSE(storage.get("k").has_value());
+}
+
+TEST_F(KVStorageTest, OverwriteReplacesExpiry) {
+  KVStorage<TestClock> storage({});
+  storage.set("k", "old", 5);
+  storage.set("k", "new");
+
+  TestClock::advance(6s);
+  EXPECT_EQ(storage.get("k"), "new");
+  EXPECT_FALSE(storage.removeOneExpiredEntry().has_value());
+  EXPECT_EQ(storage.get("k"), "new");
+}
+
+TEST_F(KVStorageTest, CompactRecord) {
+  // value + expiry + упакованные last_access и slot
+  EXPECT_EQ(sizeof(KVStorage<TestClock>::Record),
+            sizeof(string) + 2 * sizeof(uint64_t));
+}
+
+// 10. Разнесение истечения и ограничение скорости удаления
+TEST_F(KVStorageTest, ExpiryJitterSpreadsDeadlines) {
+  KVStorageOptions options;
+  options.expiry_jitter = 10s;
+  vector<tuple<string, string, uint32_t>> entries;
+  for (int i = 0; i < 1000; ++i) {
+    entries.emplace_back("key" + to_string(i), "value", 10);
+  }
+  KVStorage<TestClock> storage(entries, TestClock{}, options);
+
+  auto alive = [&] {
+    int count = 0;
+    for (int i = 0; i < 1000; ++i) {
+      count += storage.get("key" + to_string(i)).has_value();
+    }
+    return count;
+  };
+
+  TestClock::advance(10s);
+  EXPECT_EQ(alive(), 1000); // jitter только продлевает TTL
+  TestClock::advance(5s);
+  EXPECT_GT(alive(), 300);
+  EXPECT_LT(alive(), 700);
+  TestClock::advance(5s);
+  EXPECT_EQ(alive(), 0);
+}
+
+TEST_F(KVStorageTest, JitterDoesNotApplyToDeadlines) {
+  KVStorageOptions options;
+  options.expiry_jitter = 1h;
+  KVStorage<TestClock> storage({}, TestClock{}, options);
+  storage.setWithDeadline("k", "v", TestClock::now() + 1s);
+  TestClock::advance(1s);
+  EXPECT_FALSE(storage.get("k").has_value());
+}
+
+TEST_F(KVStorageTest, RemoveExpiredEntriesBatch) {
+  KVStorage<TestClock> storage({});
+  for (int i = 0; i < 10; ++i) {
+    storage.set("key" + to_string(i), "value", i < 7 ? 1 : 100);
+  }
+  TestClock::advance(2s);
+  EXPECT_EQ(storage.removeExpiredEntries(5), 5);
+  EXPECT_EQ(storage.removeExpiredEntries(5), 2);
+  EXPECT_EQ(storage.removeExpiredEntries(5), 0);
+  EXPECT_EQ(storage.get("key9"), "value");
+}
+
+TEST_F(KVStorageTest, ExpirationRateLimit) {
+  KVStorageOptions options;
+  options.max_expirations_per_second = 10;
+  KVStorage<TestClock> storage({}, TestClock{}, options);
+  for (int i = 0; i < 100; ++i) {
+    storage.set("key" + to_string(i), "value", 1);
+  }
+  TestClock::advance(2s);
+
+  EXPECT_EQ(storage.removeExpiredEntries(1000), 10);
+  EXPECT_FALSE(storage.removeOneExpiredEntry().has_value());
+
+  TestClock::advance(500ms);
+  EXPECT_EQ(storage.removeExpiredEntries(1000), 5);
+
+  // Бакет не копит больше одной секунды работы
+  TestClock::advance(10s);
+  EXPECT_EQ(storage.removeExpiredEntries(1000), 10);
+  EXPECT_TRUE(storage.removeOneExpiredEntry() == nullopt);
+}
+
+// 11. Вытеснение по приближённому LRU
+TEST_F(KVStorageTest, EvictionKeepsRecordLimit) {
+  KVStorageOptions options;
+  options.max_records = 100;
+  KVStorage<TestClock> storage({}, TestClock{}, options);
+  for (int i = 0; i < 1000; ++i) {
+    storage.set("key" + to_string(i), "value");
+    TestClock::advance(1ms);
+  }
+  EXPECT_EQ(storage.getManySorted("", 1000).size(), 100);
+  EXPECT_EQ(storage.get("key999"), "value"); // только что записанный
+  for (int i = 0; i < 100; ++i) {
+    storage.remove("key" + to_string(i));
+  }
+  storage.set("fresh", "value");
+  EXPECT_EQ(storage.get("fresh"), "value");
+}
+
+TEST_F(KVStorageTest, EvictionPrefersStaleRecords) {
+  KVStorageOptions options;
+  options.max_records = 50;
+  options.eviction_samples = 10;
+  KVStorage<TestClock> storage({}, TestClock{}, options);
+  for (int i = 0; i < 50; ++i) {
+    storage.set("key" + to_string(i), "value");
+  }
+  TestClock::advance(1s);
+  // Горячая половина читается, холодная нет
+  for (int round = 0; round < 10; ++round) {
+    for (int i = 0; i < 25; ++i) {
+      storage.get("key" + to_string(i));
+    }
+    TestClock::advance(10ms);
+  }
+  for (int i = 0; i < 20; ++i) {
+    storage.set("new" + to_string(i), "value");
+    TestClock::advance(1ms);
+    for (int j = 0; j < 25; ++j) {
+      storage.get("key" + to_string(j));
+    }
+  }
+
+  int hot_alive = 0;
+  for (int i = 0; i < 25; ++i) {
+    hot_alive += storage.get("key" + to_string(i)).has_value();
+  }
+  EXPECT_GE(hot_alive, 22);
+}
+
+TEST_F(KVStorageTest, EvictionPrefersExpiredRecords) {
+  KVStorageOptions options;
+  options.max_records = 3;
+  options.eviction_samples = 30;
+  KVStorage<TestClock> storage({}, TestClock{}, options);
+  storage.set("key1", "value");
+  storage.set("key2", "value");
+  TestClock::advance(1s);
+  // Самая свежая по доступу, но истёкшая к моменту вытеснения
+  storage.set("expired", "value", 1);
+  TestClock::advance(2s);
+  storage.set("new", "value");
+  EXPECT_FALSE(storage.removeOneExpiredEntry().has_value());
+  EXPECT_EQ(storage.get("key1"), "value");
+  EXPECT_EQ(storage.get("key2"), "value");
+}
+
+// 12. Пространства имён
+TEST_F(KVStorageTest, NamespacesAreIsolated) {
+  KVStorage<TestClock> storage({});
+  auto a = storage.createNamespace("tenant_a");
+  auto b = storage.createNamespace("tenant_b");
+  EXPECT_EQ(storage.createNamespace("tenant_a"), a);
+  EXPECT_EQ(storage.findNamespace("tenant_b"), b);
+  EXPECT_FALSE(storage.findNamespace("tenant_c").has_value());
+
+  storage.set(a, "key", "from_a");
+  storage.set(b, "key", "from_b", 5);
+  storage.set("key", "default");
+
+  EXPECT_EQ(storage.get(a, "key"), "from_a");
+  EXPECT_EQ(storage.get(b, "key"), "from_b");
+  EXPECT_EQ(storage.get("key"), "default");
+
+  auto scan = storage.getManySorted(a, "", 10);
+  ASSERT_EQ(scan.size(), 1);
+  EXPECT_EQ(scan[0].second, "from_a");
+
+  EXPECT_TRUE(storage.remove(a, "key"));
+  EXPECT_FALSE(storage.get(a, "key").has_value());
+  EXPECT_EQ(storage.get(b, "key"), "from_b");
+}
+
+TEST_F(KVStorageTest, ExpiryAcrossNamespaces) {
+  KVStorage<TestClock> storage({});
+  auto a = storage.createNamespace("a");
+  auto b = storage.createNamespace("b");
+  storage.set(a, "late", "v", 20);
+  storage.set(b, "early", "v", 10);
+  storage.set("never", "v");
+
+  TestClock::advance(30s);
+  auto first = storage.removeOneExpiredEntry();
+  ASSERT_TRUE(first.has_value());
+  EXPECT_EQ(first->first, "early");
+  EXPECT_EQ(storage.removeExpiredEntries(10), 1);
+  EXPECT_EQ(storage.namespaceStats(a).expirations, 1);
+  EXPECT_EQ(storage.namespaceStats(b).expirations, 1);
+  EXPECT_EQ(storage.get("never"), "v");
+}
+
+TEST_F(KVStorageTest, NamespaceRecordQuota) {
+  KVStorage<TestClock> storage({});
+  auto small = storage.createNamespace("small", {.max_records = 10});
+  auto other = storage.createNamespace("other");
+  for (int i = 0; i < 100; ++i) {
+    storage.set(small, "key" + to_string(i), "value");
+    storage.set(other, "key" + to_string(i), "value");
+  }
+  auto stats = storage.namespaceStats(small);
+  EXPECT_EQ(stats.records, 10);
+  EXPECT_EQ(stats.evictions, 90);
+  EXPECT_EQ(storage.namespaceStats(other).records, 100);
+}
+
+TEST_F(KVStorageTest, NamespaceByteQuota) {
+  using Storage = KVStorage<TestClock>;
+  Storage storage({});
+  size_t per_record = 4 + 100 + Storage::kRecordOverhead; // "keyN" + value
+  auto ns = storage.createNamespace("bytes", {.max_bytes = 5 * per_record});
+  for (int i = 0; i < 10; ++i) {
+    storage.set(ns, "key" + to_string(i), string(100, 'x'));
+  }
+  auto stats = storage.namespaceStats(ns);
+  EXPECT_EQ(stats.records, 5);
+  EXPECT_LE(stats.bytes, 5 * per_record);
+
+  // Перезапись большим значением вытесняет соседей, но не саму запись
+  storage.set(ns, "key9", string(400, 'x'));
+  EXPECT_EQ(storage.get(ns, "key9"), string(400, 'x'));
+  EXPECT_LE(storage.namespaceStats(ns).bytes, 5 * per_record);
+}
+
+TEST_F(KVStorageTest, NamespaceStats) {
+  KVStorage<TestClock> storage({});
+  auto ns = storage.createNamespace("stats");
+  storage.set(ns, "a", "1");
+  storage.set(ns, "b", "2");
+  storage.get(ns, "a");
+  storage.get(ns, "missing");
+  storage.remove(ns, "b");
+
+  auto stats = storage.namespaceStats(ns);
+  EXPECT_EQ(stats.records, 1);
+  EXPECT_EQ(stats.sets, 2);
+  EXPECT_EQ(stats.gets, 2);
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.removes, 1);
+  EXPECT_EQ(storage.namespaceStats().gets, 0);
+}
+
+TEST_F(KVStorageTest, EmptyNamespaceNameIsDefault) {
+  KVStorage<TestClock> storage({});
+  EXPECT_EQ(storage.createNamespace(""),
+            KVStorage<TestClock>::kDefaultNamespace);
+  EXPECT_EQ(storage.findNamespace(""),
+            KVStorage<TestClock>::kDefaultNamespace);
+  storage.set(*storage.findNamespace(""), "k", "v");
+  EXPECT_EQ(storage.get("k"), "v");
+}
+
+TEST_F(KVStorageTest, UnknownNamespaceIdThrows) {
+  KVStorage<TestClock> other({});
+  auto foreign = other.createNamespace("a");
+  KVStorage<TestClock> storage({});
+  EXPECT_THROW(storage.set(foreign, "k", "v"), out_of_range);
+  EXPECT_THROW(storage.get(foreign, "k"), out_of_range);
+  EXPECT_THROW(storage.remove(foreign, "k"), out_of_range);
+  EXPECT_THROW(storage.namespaceStats(foreign), out_of_range);
+  EXPECT_THROW(storage.getManySorted(foreign, "", 1), out_of_range);
+  // После ошибки блокировка отпущена
+  storage.set("k", "v");
+  EXPECT_EQ(storage.get("k"), "v");
+}
+
+TEST_F(KVStorageTest, GetCountersSumAcrossThreads) {
+  KVStorage<TestClock> storage({});
+  storage.set("a", "1");
+  vector<thread> readers;
+  for (int t = 0; t < 20; ++t) {
+    readers.emplace_back([&] {
+      for (int i = 0; i < 1000; ++i) {
+        storage.get(i % 2 ? "a" : "missing");
+      }
+    });
+  }
+  for (auto &reader : readers) {
+    reader.join();
+  }
+  auto stats = storage.namespaceStats();
+  EXPECT_EQ(stats.gets, 20000);
+  EXPECT_EQ(stats.hits, 10000);
+  EXPECT_EQ(storage.metrics().namespaces[0].stats.gets, 20000);
+}
+
+// 13. Допуск записей
+TEST_F(KVStorageTest, TrySetRejectsOverWriteRate) {
+  KVStorageOptions options;
+  options.max_writes_per_second = 10;
+  vector<tuple<string, string, uint32_t>> entries;
+  for (int i = 0; i < 100; ++i) {
+    entries.emplace_back("bulk" + to_string(i), "v", 0);
+  }
+  // Начальная загрузка не тратит токены
+  KVStorage<TestClock> storage(entries, TestClock{}, options);
+
+  int accepted = 0;
+  for (int i = 0; i < 20; ++i) {
+    accepted += storage.trySet("key" + to_string(i), "value");
+  }
+  EXPECT_EQ(accepted, 10);
+  EXPECT_FALSE(storage.get("key15").has_value());
+
+  // Токены пополняются по steady_clock, часы хранилища не влияют
+  TestClock::advance(10s);
+  EXPECT_FALSE(storage.trySet("stopped", "value"));
+  this_thread::sleep_for(500ms);
+  accepted = 0;
+  for (int i = 0; i < 20; ++i) {
+    accepted += storage.trySet("later" + to_string(i), "value");
+  }
+  EXPECT_EQ(accepted, 5);
+
+  auto stats = storage.admissionStats();
+  EXPECT_EQ(stats.admitted, 15);
+  EXPECT_EQ(stats.rejected, 26);
+}
+
+TEST_F(KVStorageTest, TrySetRejectsOverByteRate) {
+  KVStorageOptions options;
+  options.max_write_bytes_per_second = 10000;
+  options.admission_burst = 100ms; // 1000 байт
+  KVStorage<TestClock> storage({}, TestClock{}, options);
+  EXPECT_TRUE(storage.trySet("k1", string(598, 'x'))); // 600 байт
+  EXPECT_FALSE(storage.trySet("k2", string(598, 'x')));
+  EXPECT_TRUE(storage.trySet("k3", string(398, 'x')));
+  this_thread::sleep_for(100ms);
+  // Запись больше бакета проходит только при полном бакете
+  EXPECT_TRUE(storage.trySet("big", string(5000, 'x')));
+  EXPECT_FALSE(storage.trySet("k4", "v"));
+}
+
+TEST_F(KVStorageTest, SetWaitsForWriteTokens) {
+  KVStorageOptions options;
+  options.max_writes_per_second = 100;
+  options.admission_burst = 10ms;
+  KVStorage<TestClock> storage({}, TestClock{}, options);
+  auto start = steady_clock::now();
+  for (int i = 0; i < 5; ++i) {
+    storage.set("key" + to_string(i), "value");
+  }
+  // Время хранилища стоит, но долг гасится по steady_clock: каждая
+  // следующая запись ждёт не больше одного токена (10ms), а не всё дольше
+  EXPECT_GE(steady_clock::now() - start, 30ms);
+  auto stats = storage.admissionStats();
+  EXPECT_EQ(stats.admitted, 5);
+  EXPECT_EQ(stats.delayed, 4);
+  EXPECT_GE(stats.total_delay, 30ms);
+  EXPECT_LE(stats.total_delay, 41ms);
+  EXPECT_EQ(storage.get("key4"), "value");
+}
+
+TEST_F(KVStorageTest, ReaderPriority) {
+  KVStorageOptions options;
+  options.reader_priority = true;
+  KVStorage<TestClock> storage({}, TestClock{}, options);
+  atomic<bool> stop{false};
+  vector<thread> readers;
+  for (int i = 0; i < 2; ++i) {
+    readers.emplace_back([&] {
+      while (!stop) {
+        storage.get("key");
+        storage.getManySorted("", 10);
+      }
+    });
+  }
+  for (int i = 0; i < 200; ++i) {
+    storage.set("key", to_string(i));
+  }
+  stop = true;
+  for (auto &t : readers) {
+    t.join();
+  }
+  EXPECT_EQ(storage.get("key"), "199");
+}
+
+// 14. Чтение с ограниченным ожиданием
+// Блокировка, которую тест может занять в обход хранилища: все экземпляры
+// делят один Mutex.
+template <typename Mutex> struct GlobalLock {
+  static Mutex &global() {
+    static Mutex mutex;
+    return mutex;
+  }
+  void lock() { global().lock(); }
+  bool try_lock() { return global().try_lock(); }
+  void unlock() { global().unlock(); }
+  void lock_shared() { global().lock_shared(); }
+  bool try_lock_shared() { return global().try_lock_shared(); }
+  void unlock_shared() { global().unlock_shared(); }
+};
+
+struct TimedGlobalLock : GlobalLock<shared_timed_mutex> {
+  template <typename C, typename D>
+  bool try_lock_shared_until(const time_point<C, D> &deadline) {
+    return global().try_lock_shared_until(deadline);
+  }
+};
+
+template <typename Lock> void checkTryGetTimesOut() {
+  KVStorageOptions options;
+  options.slowlog_capacity = 8;
+  options.slowlog_threshold = 0us;
+  options.latency_histograms = true;
+  KVStorage<TestClock, Lock> storage({}, TestClock{}, options);
+  storage.set("key", "value");
+  storage.set("next", "value");
+  // Блокировку держит другой поток: pthread_rwlock сразу отказывает
+  // потоку, который сам держит её на запись.
+  atomic<bool> locked{false};
+  atomic<bool> release{false};
+  thread writer([&] {
+    unique_lock l(Lock::global());
+    locked = true;
+    while (!release) {
+      this_thread::yield();
+    }
+  });
+  while (!locked) {
+    this_thread::yield();
+  }
+  auto start = steady_clock::now();
+  EXPECT_FALSE(storage.tryGet("key", start + 5ms).has_value());
+  EXPECT_GE(steady_clock::now() - start, 5ms);
+  EXPECT_FALSE(
+      storage.tryGetManySorted("", 10, steady_clock::now() + 1ms).has_value());
+  release = true;
+  writer.join();
+  EXPECT_EQ(storage.admissionStats().read_timeouts, 2);
+  // Отказ по сроку - не операция: ни slowlog, ни гистограмма.
+  auto reads = [&] {
+    size_t logged = 0;
+    for (auto &entry : storage.slowlog()) {
+      logged += entry.operation != kv_slowlog::Operation::Set;
+    }
+    return logged;
+  };
+  EXPECT_EQ(reads(), 0);
+  for (auto &[operation, latency] : storage.metrics().latencies) {
+    if (operation != kv_slowlog::Operation::Set) {
+      EXPECT_EQ(latency.count, 0) << kv_slowlog::name(operation);
+    }
+  }
+  auto deadline = steady_clock::now() + 1s;
+  EXPECT_EQ(storage.tryGet("key", deadline), "value");
+  EXPECT_FALSE(storage.tryGet("missing", deadline).has_value());
+  auto scan = storage.tryGetManySorted("", 10, deadline);
+  ASSERT_TRUE(scan.has_value());
+  EXPECT_EQ(scan->records.size(), 2);
+  EXPECT_FALSE(scan->truncated);
+  EXPECT_EQ(storage.admissionStats().read_timeouts, 2);
+  EXPECT_EQ(reads(), 3);
+}
+
+TEST_F(KVStorageTest, TryGetTimesOutWithSpin) {
+  checkTryGetTimesOut<GlobalLock<shared_mutex>>();
+}
+
+TEST_F(KVStorageTest, TryGetTimesOutWithTimedLock) {
+  checkTryGetTimesOut<TimedGlobalLock>();
+}
+
+// Отдаёт читателям не больше shared_grants блокировок.
+struct RationedLock : GlobalLock<shared_mutex> {
+  static inline int shared_grants = 0;
+  bool try_lock_shared() {
+    if (shared_grants == 0) {
+      return false;
+    }
+    --shared_grants;
+    return global().try_lock_shared();
+  }
+};
+
+TEST_F(KVStorageTest, TryGetManySortedReportsTruncation) {
+  KVStorageOptions options;
+  options.scan_chunk_size = 3;
+  KVStorage<TestClock, RationedLock> storage({}, TestClock{}, options);
+  for (int i = 0; i < 10; ++i) {
+    storage.set("key" + to_string(i), "v" + to_string(i), i == 2 ? 1 : 0);
+  }
+  TestClock::advance(2s);
+  // Первый участок (key0..key2) читается, повторный захват не удаётся.
+  RationedLock::shared_grants = 1;
+  auto scan = storage.tryGetManySorted("", 10, steady_clock::now() + 1ms);
+  ASSERT_TRUE(scan.has_value());
+  vector<pair<string, string>> expected = {{"key0", "v0"}, {"key1", "v1"}};
+  EXPECT_EQ(scan->records, expected);
+  EXPECT_TRUE(scan->truncated);
+  EXPECT_EQ(scan->resume_key, "key2");
+
+  RationedLock::shared_grants = 100;
+  scan = storage.tryGetManySorted(scan->resume_key, 10,
+                                  steady_clock::now() + 1s);
+  ASSERT_TRUE(scan.has_value());
+  EXPECT_EQ(scan->records.size(), 7);
+  EXPECT_EQ(scan->records.front().first, "key3");
+  EXPECT_FALSE(scan->truncated);
+  EXPECT_TRUE(scan->resume_key.empty());
+}
+
+TEST_F(KVStorageTest, LongScanYieldsToWriters) {
+  KVStorage<TestClock> storage({});
+  for (int i = 0; i < 10000; ++i) {
+    storage.set("key" + to_string(100000 + i), "value");
+  }
+  atomic<bool> stop{false};
+  thread writer([&] {
+    for (int i = 0; !stop; ++i) {
+      auto key = "key" + to_string(100000 + i % 10000);
+      storage.remove(key);
+      storage.set(key + "a", "value");
+    }
+  });
+  for (int round = 0; round < 20; ++round) {
+    auto result = storage.getManySorted("", 100000);
+    // Между remove и set ключа нет: обход может пропустить по одному
+    // ключу на каждый участок между уступками
+    EXPECT_GE(result.size(), 9980);
+    for (size_t i = 1; i < result.size(); ++i) {
+      ASSERT_LT(result[i - 1].first, result[i].first);
+    }
+  }
+  stop = true;
+  writer.join();
+}
+
+TEST_F(KVStorageTest, ScanChunkSizes) {
+  for (uint32_t chunk : {0u, 1u, 3u, 1024u}) {
+    KVStorageOptions options;
+    options.scan_chunk_size = chunk;
+    KVStorage<TestClock> storage({}, TestClock{}, options);
+    for (int i = 0; i < 20; ++i) {
+      storage.set("key" + to_string(10 + i), "v" + to_string(i),
+                  i % 4 == 0 ? 1 : 0);
+    }
+    TestClock::advance(2s);
+    auto result = storage.getManySorted("key12", 8);
+    vector<pair<string, string>> expected = {
+        {"key13", "v3"}, {"key15", "v5"}, {"key16", "v6"}, {"key17", "v7"},
+        {"key19", "v9"}, {"key20", "v10"}, {"key21", "v11"}, {"key23", "v13"}};
+    EXPECT_EQ(result, expected) << "chunk " << chunk;
+  }
+}
+
+TEST_F(KVStorageTest, ChunkedScanRevalidatesAfterErase) {
+  KVStorageOptions options;
+  options.scan_chunk_size = 2;
+  KVStorage<TestClock> storage({}, TestClock{}, options);
+  for (int i = 0; i < 200; ++i) {
+    storage.set("key" + to_string(10000 + i), "value");
+  }
+  atomic<bool> stop{false};
+  thread writer([&] {
+    for (int i = 0; !stop; ++i) {
+      storage.remove("key" + to_string(10000 + i % 200));
+      storage.set("key" + to_string(10000 + (i + 100) % 200), "value");
+    }
+  });
+  for (int round = 0; round < 5; ++round) {
+    auto result = storage.getManySorted("", 10000);
+    for (size_t i = 1; i < result.size(); ++i) {
+      ASSERT_LT(result[i - 1].first, result[i].first);
+    }
+  }
+  stop = true;
+  writer.join();
+}
+
+// 15. Размещение по трассе обращений
+TEST_F(KVStorageTest, AccessRecorderSamplesSequences) {
+  KVStorageOptions options;
+  options.access_sample_one_in = 1;
+  options.access_sequence_length = 4;
+  KVStorage<TestClock> storage({}, TestClock{}, options);
+  storage.set("a", "1");
+  for (auto key : {"a", "b", "c", "d", "e", "f", "g", "h", "i"}) {
+    storage.get(key);
+  }
+  auto sequences = storage.accessRecorder()->sequences();
+  vector<vector<string>> expected = {{"a", "b", "c", "d"},
+                                     {"e", "f", "g", "h"}};
+  EXPECT_EQ(sequences, expected);
+
+  KVStorage<TestClock> disabled({});
+  EXPECT_EQ(disabled.accessRecorder(), nullptr);
+}
+
+TEST_F(KVStorageTest, AccessRecorderKeepsCountdownPerStorage) {
+  // Поток читает попеременно из двух хранилищ: каждое по-прежнему
+  // начинает последовательность раз в access_sample_one_in обращений.
+  KVStorageOptions options;
+  options.access_sample_one_in = 3;
+  options.access_sequence_length = 2;
+  KVStorage<TestClock> first({}, TestClock{}, options);
+  KVStorage<TestClock> second({}, TestClock{}, options);
+  for (int i = 0; i < 30; ++i) {
+    first.get("a" + to_string(i));
+    second.get("b" + to_string(i));
+  }
+  EXPECT_EQ(first.accessRecorder()->sequences().size(), 7);
+  EXPECT_EQ(second.accessRecorder()->sequences().size(), 7);
+}
+
+TEST_F(KVStorageTest, BuildLayoutGroupsCoAccessedKeys) {
+  vector<vector<string>> sequences;
+  for (int i = 0; i < 10; ++i) {
+    sequences.push_back({"u1:profile", "u1:settings", "u2:profile",
+                         "u2:settings", "u1:profile", "u1:settings"});
+  }
+  sequences.push_back({"lonely"});
+  auto order = kv_access::buildLayout(sequences, 2, 2);
+  vector<string> expected = {"u1:profile", "u1:settings", "u2:profile",
+                             "u2:settings"};
+  EXPECT_EQ(order, expected);
+}
+
+TEST_F(KVStorageTest, AccessTraceRoundTrip) {
+  vector<vector<string>> sequences = {{"plain", "with space", "back\\slash"},
+                                      {string("nul\0byte", 8), "\n"}};
+  auto path = testing::TempDir() + "kv_access_trace.txt";
+  ASSERT_FALSE(kv_access::saveSequences(path, sequences));
+  vector<vector<string>> loaded;
+  ASSERT_FALSE(kv_access::loadSequences(path, loaded));
+  EXPECT_EQ(loaded, sequences);
+
+  vector<string> hint = {"b", "a c"};
+  ASSERT_FALSE(kv_access::saveHint(path, hint));
+  vector<string> loaded_hint;
+  ASSERT_FALSE(kv_access::loadHint(path, loaded_hint));
+  EXPECT_EQ(loaded_hint, hint);
+  remove(path.c_str());
+}
+
+TEST_F(KVStorageTest, RelayoutPreservesRecords) {
+  KVStorageOptions options;
+  options.max_records = 100;
+  KVStorage<TestClock> storage({}, TestClock{}, options);
+  for (int i = 0; i < 100; ++i) {
+    storage.set("key" + to_string(100 + i), string(i, 'v'),
+                i % 10 == 0 ? 1 : 0);
+  }
+  vector<string> hint = {"key150", "key105", "missing", "key150"};
+  storage.relayout(hint);
+
+  for (int i = 0; i < 100; ++i) {
+    ASSERT_EQ(storage.get("key" + to_string(100 + i)), string(i, 'v'));
+  }
+  EXPECT_EQ(storage.getManySorted("", 1000).size(), 100);
+  EXPECT_TRUE(storage.remove("key105"));
+  EXPECT_EQ(storage.namespaceStats().records, 99);
+
+  // Очередь истечения и вытеснение работают с новыми узлами
+  TestClock::advance(2s);
+  EXPECT_EQ(storage.removeExpiredEntries(100), 10);
+  for (int i = 0; i < 20; ++i) {
+    storage.set("new" + to_string(i), "v");
+  }
+  EXPECT_EQ(storage.namespaceStats().records, 100);
+}
+
+// 16. Huge pages
+TEST_F(KVStorageTest, HugePagesBackIndex) {
+  KVStorageOptions options;
+  options.huge_pages = true;
+  KVStorage<TestClock> storage({}, TestClock{}, options);
+  auto ns = storage.createNamespace("other");
+  for (int i = 0; i < 20000; ++i) {
+    storage.set("key" + to_string(i), to_string(i));
+    storage.set(ns, "key" + to_string(i), string(40, 'v'));
+  }
+  // Какой бы способ ни сработал, память пришла из ресурса целыми
+  // 2 МиБ страницами.
+  auto stats = storage.hugePageStats();
+  auto total =
+      stats.explicit_bytes + stats.transparent_bytes + stats.regular_bytes;
+  EXPECT_GT(total, 0);
+  EXPECT_EQ(total % kv_memory::HugePageResource::kHugePageSize, 0);
+
+  for (int i = 0; i < 20000; i += 2) {
+    ASSERT_TRUE(storage.remove("key" + to_string(i)));
+  }
+  for (int i = 0; i < 20000; ++i) {
+    auto value = storage.get("key" + to_string(i));
+    ASSERT_EQ(value, i % 2 ? optional(to_string(i)) : nullopt);
+    ASSERT_EQ(storage.get(ns, "key" + to_string(i)), string(40, 'v'));
+  }
+
+  vector<string> hint = {"key7", "key3"};
+  storage.relayout(hint);
+  EXPECT_EQ(storage.get("key7"), "7");
+  EXPECT_EQ(storage.namespaceStats().records, 10000);
+}
+
+TEST_F(KVStorageTest, HugePageStatsDropWhenLargeBlocksAreFreed) {
+  kv_memory::HugePageResource resource;
+  auto total = [&] {
+    auto stats = resource.stats();
+    return stats.explicit_bytes + stats.transparent_bytes +
+           stats.regular_bytes;
+  };
+  constexpr size_t kPage = kv_memory::HugePageResource::kHugePageSize;
+  void *small = resource.allocate(64);
+  EXPECT_EQ(total(), kPage);
+  void *large = resource.allocate(3 * kPage);
+  EXPECT_EQ(total(), 4 * kPage);
+  resource.deallocate(large, 3 * kPage);
+  EXPECT_EQ(total(), kPage);
+  // Мелкие блоки живут до разрушения ресурса
+  resource.deallocate(small, 64);
+  EXPECT_EQ(total(), kPage);
+}
+
+TEST_F(KVStorageTest, HugePagesDisabledByDefault) {
+  KVStorage<TestClock> storage({});
+  storage.set("a", "1");
+  auto stats = storage.hugePageStats();
+  EXPECT_EQ(stats.explicit_bytes + stats.transparent_bytes +
+                stats.regular_bytes,
+            0);
+}
+
+// 17. Пакетное чтение
+TEST_F(KVStorageTest, GetManyMatchesGet) {
+  for (uint32_t group : {0u, 1u, 3u, 8u, 64u}) {
+    KVStorageOptions options;
+    options.prefetch_group = group;
+    KVStorage<TestClock> storage({}, TestClock{}, options);
+    auto ns = storage.createNamespace("other");
+    for (int i = 0; i < 500; i += 2) {
+      storage.set("key" + to_string(i), string(i % 40, 'v'),
+                  i % 10 == 0 ? 1 : 0);
+    }
+    storage.set(ns, "key1", "other");
+    TestClock::advance(2s);
+
+    vector<string> names;
+    for (int i = 499; i >= 0; --i) {
+      names.push_back("key" + to_string(i));
+    }
+    names.push_back("");
+    names.push_back("key1");
+    vector<string_view> keys(begin(names), end(names));
+
+    auto values = storage.getMany(keys);
+    ASSERT_EQ(values.size(), keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+      ASSERT_EQ(values[i], storage.get(keys[i])) << keys[i];
+    }
+    EXPECT_EQ(values[0], nullopt);
+    EXPECT_EQ(values[1], string(498 % 40, 'v'));
+    EXPECT_EQ(values[10], nullopt); // key490 истёк
+
+    auto other = storage.getMany(ns, span(keys).last(2));
+    EXPECT_EQ(other[0], nullopt);
+    EXPECT_EQ(other[1], "other");
+    EXPECT_TRUE(storage.getMany({}).empty());
+  }
+}
+
+TEST_F(KVStorageTest, GetManyCountsStats) {
+  KVStorage<TestClock> storage({});
+  storage.set("a", "1");
+  storage.set("b", "2");
+  vector<string_view> keys = {"a", "b", "c"};
+  storage.getMany(keys);
+  auto stats = storage.namespaceStats();
+  EXPECT_EQ(stats.gets, 3);
+  EXPECT_EQ(stats.hits, 2);
+}
+
+TEST_F(KVStorageTest, CoroutineGetManyMatchesGet) {
+  for (uint32_t lanes : {1u, 3u, 16u}) {
+    KVStorageOptions options;
+    options.prefetch_group = lanes;
+    options.coroutine_lookups = true;
+    options.access_sample_one_in = 1;
+    options.access_sequence_length = 4;
+    KVStorage<TestClock> storage({}, TestClock{}, options);
+    for (int i = 0; i < 300; i += 3) {
+      storage.set("key" + to_string(i), string(i % 30, 'v'),
+                  i % 9 == 0 ? 1 : 0);
+    }
+    TestClock::advance(2s);
+
+    vector<string> names;
+    for (int i = 0; i < 300; ++i) {
+      names.push_back("key" + to_string(i * 7 % 300));
+    }
+    vector<string_view> keys(begin(names), end(names));
+    auto values = storage.getMany(keys);
+    ASSERT_EQ(values.size(), keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+      ASSERT_EQ(values[i], storage.get(keys[i])) << keys[i];
+    }
+    // Трасса обращений пишется в порядке keys, а не завершения поисков
+    auto sequences = storage.accessRecorder()->sequences();
+    ASSERT_FALSE(sequences.empty());
+    EXPECT_EQ(sequences[0], vector<string>(begin(names), begin(names) + 4));
+  }
+}
+
+// 18. Разделяемые значения
+TEST_F(KVStorageTest, InternSharesLongValues) {
+  KVStorageOptions options;
+  options.intern_max_value_size = 64;
+  options.max_records = 1000;
+  KVStorage<TestClock> storage({}, TestClock{}, options);
+  string status = "STATUS_PENDING_REVIEW";
+  for (int i = 0; i < 100; ++i) {
+    storage.set("key" + to_string(i), status);
+  }
+  storage.set("short", "1");
+  storage.set("long", string(100, 'x'));
+
+  auto stats = storage.internStats();
+  EXPECT_EQ(stats.values, 1);
+  EXPECT_EQ(stats.references, 100);
+  EXPECT_EQ(stats.bytes_saved, 99 * (status.size() + 1));
+  EXPECT_EQ(storage.get("key7"), status);
+  EXPECT_EQ(storage.get("short"), "1");
+  EXPECT_EQ(storage.get("long"), string(100, 'x'));
+  EXPECT_EQ(storage.getManySorted("key98", 1)[0].second, status);
+
+  // Перезапись, удаление и истечение отпускают ссылку
+  storage.set("key0", "other");
+  EXPECT_TRUE(storage.remove("key1"));
+  storage.set("key2", status, 1);
+  TestClock::advance(2s);
+  auto expired = storage.removeOneExpiredEntry();
+  ASSERT_TRUE(expired);
+  EXPECT_EQ(expired->second, status);
+  EXPECT_EQ(storage.internStats().references, 97);
+
+  vector<string> hint;
+  storage.relayout(hint);
+  EXPECT_EQ(storage.get("key50"), status);
+  EXPECT_EQ(storage.internStats().references, 97);
+
+  for (int i = 3; i < 100; ++i) {
+    storage.remove("key" + to_string(i));
+  }
+  stats = storage.internStats();
+  EXPECT_EQ(stats.values, 0);
+  EXPECT_EQ(stats.bytes_saved, 0);
+}
+
+// 19. Распределения размеров и TTL
+TEST_F(KVStorageTest, DistributionStatsTrackSizesTtlAndPrefixes) {
+  KVStorageOptions options;
+  options.distribution_stats = true;
+  options.max_prefixes = 2;
+  KVStorage<TestClock> storage({}, TestClock{}, options);
+  for (int i = 0; i < 10; ++i) {
+    storage.set("user:" + to_string(i), string(100, 'v'), 100);
+  }
+  for (int i = 0; i < 5; ++i) {
+    storage.set("session:" + to_string(i), "1", 10);
+  }
+  storage.set("plain", "");
+  storage.set("order:1", "x"); // префиксов уже 2 - в other
+
+  auto stats = storage.distributionStats();
+  EXPECT_EQ(stats.key_sizes.total(), 17);
+  EXPECT_EQ(stats.value_sizes.total(), 17);
+  // 100 байт - корзина [64, 128)
+  EXPECT_EQ(stats.value_sizes.count(kv_sketch::Log2Histogram::bucketOf(100)),
+            10);
+  EXPECT_EQ(stats.value_sizes.count(0), 1);
+  EXPECT_EQ(stats.value_sizes.quantile(0.9), 64);
+  EXPECT_EQ(stats.without_ttl, 2);
+  EXPECT_EQ(stats.remaining_ttl.total(), 15);
+  EXPECT_EQ(stats.remaining_ttl.count(
+                kv_sketch::Log2Histogram::bucketOf(100)),
+            10);
+
+  ASSERT_EQ(stats.prefixes.size(), 2);
+  EXPECT_EQ(stats.prefixes[0].first, "user:");
+  EXPECT_EQ(stats.prefixes[0].second.records, 10);
+  EXPECT_EQ(stats.prefixes[0].second.bytes, 10 * (6 + 100));
+  EXPECT_EQ(stats.prefixes[1].first, "session:");
+  EXPECT_EQ(stats.other_prefixes.records, 2);
+
+  // Оставшийся TTL считается в момент запроса
+  TestClock::advance(50s);
+  stats = storage.distributionStats();
+  EXPECT_EQ(stats.remaining_ttl.count(0), 5);
+  EXPECT_EQ(stats.remaining_ttl.count(
+                kv_sketch::Log2Histogram::bucketOf(50)),
+            10);
+
+  // Перезапись, удаление и истечение вычитаются
+  storage.set("user:0", "short");
+  EXPECT_TRUE(storage.remove("order:1"));
+  EXPECT_EQ(storage.removeExpiredEntries(100), 5);
+  stats = storage.distributionStats();
+  EXPECT_EQ(stats.key_sizes.total(), 11);
+  EXPECT_EQ(stats.without_ttl, 2);
+  EXPECT_EQ(stats.remaining_ttl.total(), 9);
+  EXPECT_EQ(stats.other_prefixes.records, 1);
+  EXPECT_EQ(stats.prefixes.size(), 1);
+  EXPECT_EQ(stats.prefixes[0].second.bytes, 9 * (6 + 100) + 6 + 5);
+
+  EXPECT_TRUE(KVStorage<TestClock>({}).distributionStats().prefixes.empty());
+}
+
+TEST_F(KVStorageTest, RemainingTtlRoundsLiveRecordsUp) {
+  KVStorageOptions options;
+  options.distribution_stats = true;
+  KVStorage<TestClock> storage({}, TestClock{}, options);
+  // Срок 1.9 с при текущих 1.2 с: осталось 0.7 с, корзина 1 с, а не 0
+  TestClock::advance(1200ms);
+  storage.set("k", "v", 700ms);
+  auto stats = storage.distributionStats();
+  EXPECT_EQ(stats.remaining_ttl.count(0), 0);
+  EXPECT_EQ(stats.remaining_ttl.count(kv_sketch::Log2Histogram::bucketOf(1)),
+            1);
+  // Истёкшая, но не удалённая запись - в корзине 0 со следующей секунды
+  TestClock::advance(800ms);
+  EXPECT_EQ(storage.distributionStats().remaining_ttl.count(0), 1);
+}
+
+TEST_F(KVStorageTest, RemainingTtlFollowsQueriesIncrementally) {
+  // Гистограмма, сдвигаемая от запроса к запросу, совпадает с
+  // пересчитанной с нуля.
+  kv_sketch::Distribution distribution(':', 4);
+  mt19937_64 rng(7);
+  vector<uint64_t> seconds;
+  uint64_t now = 0;
+  for (int round = 0; round < 200; ++round) {
+    for (int i = 0; i < 20; ++i) {
+      auto second = now + rng() % (uint64_t{1} << (rng() % 20));
+      seconds.push_back(second);
+      distribution.add("k", 1, second);
+    }
+    for (int i = 0; i < 5 && !seconds.empty(); ++i) {
+      auto at = rng() % seconds.size();
+      distribution.remove("k", 1, seconds[at]);
+      seconds.erase(seconds.begin() + static_cast<ptrdiff_t>(at));
+    }
+    now += rng() % (uint64_t{1} << (rng() % 12));
+    kv_sketch::Log2Histogram expected;
+    for (auto second : seconds) {
+      expected.add(second > now ? second - now : 0);
+    }
+    auto actual = distribution.remainingTtl(now);
+    ASSERT_EQ(actual.total(), expected.total());
+    for (size_t i = 0; i < kv_sketch::Log2Histogram::kBuckets; ++i) {
+      ASSERT_EQ(actual.count(i), expected.count(i))
+          << "round " << round << " bucket " << i;
+    }
+  }
+}
+
+TEST_F(KVStorageTest, RemoveOneExpiredEntryReleasesBytes) {
+  KVStorage<TestClock> storage({});
+  storage.set("a", string(100, 'v'), 1);
+  storage.set("b", "1");
+  auto before = storage.namespaceStats().bytes;
+  TestClock::advance(2s);
+  auto removed = storage.removeOneExpiredEntry();
+  ASSERT_TRUE(removed);
+  EXPECT_EQ(removed->second, string(100, 'v'));
+  EXPECT_EQ(storage.namespaceStats().bytes,
+            before - (1 + 100 + KVStorage<TestClock>::kRecordOverhead));
+}
+
+// 20. Горячие ключи
+TEST_F(KVStorageTest, HotKeysFindFrequentReadsAndWrites) {
+  KVStorageOptions options;
+  options.hot_key_sample_one_in = 1;
+  options.hot_key_capacity = 8;
+  options.hot_key_window = 10s;
+  options.hot_key_history = 2;
+  KVStorage<TestClock> storage({}, TestClock{}, options);
+  EXPECT_TRUE(storage.hotKeys(kv_hot::Access::Read).empty());
+
+  for (int i = 0; i < 1000; ++i) {
+    storage.set("cold" + to_string(i), "v");
+    storage.get(i % 2 ? "hot" : "cold" + to_string(i));
+    if (i % 4 == 0) {
+      storage.set("counter", to_string(i));
+    }
+  }
+  auto reads = storage.hotKeys(kv_hot::Access::Read, 3);
+  ASSERT_FALSE(reads.empty());
+  EXPECT_EQ(reads[0].key, "hot");
+  EXPECT_GE(reads[0].count, 500);
+  EXPECT_LE(reads[0].count - reads[0].error, 500);
+  auto writes = storage.hotKeys(kv_hot::Access::Write, 1);
+  ASSERT_EQ(writes.size(), 1);
+  EXPECT_EQ(writes[0].key, "counter");
+
+  // Следующее окно: старые обращения видны только при windows > 1
+  TestClock::advance(10s);
+  for (int i = 0; i < 10; ++i) {
+    vector<string_view> keys = {"new", "new"};
+    storage.getMany(keys);
+  }
+  reads = storage.hotKeys(kv_hot::Access::Read, 1);
+  ASSERT_EQ(reads.size(), 1);
+  EXPECT_EQ(reads[0].key, "new");
+  EXPECT_EQ(reads[0].count, 20);
+  EXPECT_EQ(storage.hotKeys(kv_hot::Access::Read, 1, 2)[0].key, "hot");
+
+  // Окна старше hot_key_history вытесняются
+  TestClock::advance(30s);
+  EXPECT_TRUE(storage.hotKeys(kv_hot::Access::Read, 1, 10).empty());
+}
+
+TEST_F(KVStorageTest, HotKeysSampleAndScaleCounts) {
+  KVStorageOptions options;
+  options.hot_key_sample_one_in = 10;
+  KVStorage<TestClock> storage({}, TestClock{}, options);
+  for (int i = 0; i < 1000; ++i) {
+    storage.get("hot");
+  }
+  auto reads = storage.hotKeys(kv_hot::Access::Read);
+  ASSERT_EQ(reads.size(), 1);
+  EXPECT_EQ(reads[0].count, 1000);
+}
+
+TEST_F(KVStorageTest, HotKeysSampleEachStorageWhenAlternating) {
+  KVStorageOptions options;
+  options.hot_key_sample_one_in = 10;
+  KVStorage<TestClock> first({}, TestClock{}, options);
+  KVStorage<TestClock> second({}, TestClock{}, options);
+  for (int i = 0; i < 1000; ++i) {
+    first.get("one");
+    second.get("two");
+  }
+  auto reads = first.hotKeys(kv_hot::Access::Read);
+  ASSERT_EQ(reads.size(), 1);
+  EXPECT_EQ(reads[0].count, 1000);
+  reads = second.hotKeys(kv_hot::Access::Read);
+  ASSERT_EQ(reads.size(), 1);
+  EXPECT_EQ(reads[0].count, 1000);
+}
+
+// 21. Журнал медленных операций
+TEST_F(KVStorageTest, SlowlogRecordsOperationsNewestFirst) {
+  KVStorageOptions options;
+  options.slowlog_capacity = 4;
+  options.slowlog_threshold = 0us;
+  KVStorage<TestClock> storage({}, TestClock{}, options);
+  EXPECT_TRUE(storage.slowlog().empty());
+
+  string long_key(100, 'k');
+  storage.set(long_key, "v");
+  storage.set("a", "1");
+  storage.set("b", "2");
+  storage.get("a");
+  vector<string_view> keys = {"a", "b", "c"};
+  storage.getMany(keys);
+  storage.getManySorted("", 10);
+  storage.remove("a");
+
+  // В кольце четыре последние операции, от новых к старым
+  auto log = storage.slowlog();
+  ASSERT_EQ(log.size(), 4);
+  EXPECT_EQ(log[0].operation, kv_slowlog::Operation::Remove);
+  EXPECT_EQ(log[0].key, "a");
+  EXPECT_EQ(log[1].operation, kv_slowlog::Operation::GetManySorted);
+  EXPECT_EQ(log[1].count, 3);
+  EXPECT_EQ(log[2].operation, kv_slowlog::Operation::GetMany);
+  EXPECT_EQ(log[2].key, "a");
+  EXPECT_EQ(log[2].count, 3);
+  EXPECT_EQ(log[3].operation, kv_slowlog::Operation::Get);
+  for (auto &entry : log) {
+    EXPECT_GT(entry.execution.count(), 0);
+    EXPECT_GE(entry.lock_wait.count(), 0);
+  }
+  EXPECT_GE(log[0].time, log[3].time);
+
+  storage.set(long_key, "w");
+  log = storage.slowlog();
+  EXPECT_EQ(log[0].operation, kv_slowlog::Operation::Set);
+  EXPECT_EQ(log[0].key, string(kv_slowlog::kMaxKey, 'k'));
+  // Ключ новой записи перемещается в индекс, журнал видит его там
+  storage.set("c", "3");
+  EXPECT_EQ(storage.slowlog()[0].key, "c");
+}
+
+TEST_F(KVStorageTest, SlowlogSkipsFastOperations) {
+  KVStorageOptions options;
+  options.slowlog_capacity = 16;
+  options.slowlog_threshold = 1h;
+  KVStorage<TestClock> storage({}, TestClock{}, options);
+  storage.set("a", "1");
+  storage.get("a");
+  EXPECT_TRUE(storage.slowlog().empty());
+}
+
+TEST_F(KVStorageTest, SlowlogConcurrentWriters) {
+  KVStorageOptions options;
+  options.slowlog_capacity = 8;
+  options.slowlog_threshold = 0us;
+  KVStorage<TestClock> storage({}, TestClock{}, options);
+  storage.set("key", "v");
+  atomic<bool> stop{false};
+  thread reader([&] {
+    while (!stop) {
+      for (auto &entry : storage.slowlog()) {
+        ASSERT_TRUE(entry.key == "key" || entry.key == "other");
+        ASSERT_EQ(entry.count, 1);
+      }
+    }
+  });
+  vector<thread> writers;
+  for (int t = 0; t < 4; ++t) {
+    writers.emplace_back([&, t] {
+      for (int i = 0; i < 2000; ++i) {
+        if (t % 2) {
+          storage.get("key");
+        } else {
+          storage.set("other", "v");
+        }
+      }
+    });
+  }
+  for (auto &writer : writers) {
+    writer.join();
+  }
+  stop = true;
+  reader.join();
+  EXPECT_LE(storage.slowlog().size(), 8);
+  EXPECT_FALSE(storage.slowlog().empty());
+}
+
+// 22. Метрики OpenMetrics
+TEST_F(KVStorageTest, MetricsSnapshotCountsBacklogAndSizes) {
+  KVStorageOptions options;
+  options.latency_histograms = true;
+  KVStorage<TestClock> storage({}, TestClock{}, options);
+  auto users = storage.createNamespace("users");
+  storage.set("a", "1", 10);
+  storage.set("b", "2", 20);
+  storage.set("c", "3");
+  storage.set(users, "u", "v");
+  storage.set(users, "w", "v");
+  storage.get("a");
+  storage.get("missing");
+  TestClock::advance(15s);
+
+  auto snapshot = storage.metrics();
+  ASSERT_EQ(snapshot.namespaces.size(), 2);
+  auto &space = snapshot.namespaces[0];
+  EXPECT_EQ(space.name, "");
+  EXPECT_EQ(space.stats.records, 3);
+  EXPECT_EQ(space.stats.bytes, storage.namespaceStats().bytes);
+  EXPECT_EQ(space.stats.gets, 2);
+  EXPECT_EQ(space.stats.hits, 1);
+  EXPECT_EQ(space.expired_records, 1);
+  EXPECT_EQ(space.index_depth_bound, 4);
+  EXPECT_EQ(snapshot.namespaces[1].name, "users");
+  EXPECT_EQ(snapshot.namespaces[1].stats.records, 2);
+  // 2 ceil(log2(3)), а не 2 floor(log2(3)) = 2
+  EXPECT_EQ(snapshot.namespaces[1].index_depth_bound, 4);
+  ASSERT_EQ(snapshot.latencies.size(), kv_slowlog::kOperations);
+  EXPECT_EQ(snapshot.latencies[0].first, kv_slowlog::Operation::Get);
+  EXPECT_EQ(snapshot.latencies[0].second.count, 2);
+
+  storage.removeOneExpiredEntry();
+  snapshot = storage.metrics();
+  EXPECT_EQ(snapshot.namespaces[0].stats.records, 2);
+  EXPECT_EQ(snapshot.namespaces[0].stats.expirations, 1);
+  EXPECT_EQ(snapshot.namespaces[0].expired_records, 0);
+}
+
+TEST_F(KVStorageTest, OpenMetricsText) {
+  KVStorageOptions options;
+  options.latency_histograms = true;
+  KVStorage<TestClock> storage({}, TestClock{}, options);
+  storage.createNamespace("say \"hi\"\n");
+  storage.set("a", "1", 1);
+  storage.get("a");
+  TestClock::advance(2s);
+
+  auto text = storage.openMetrics();
+  EXPECT_NE(text.find("# TYPE kv_records gauge\n"), string::npos);
+  EXPECT_NE(text.find("kv_records{namespace=\"\"} 1\n"), string::npos);
+  EXPECT_NE(text.find("kv_expired_records{namespace=\"\"} 1\n"),
+            string::npos);
+  EXPECT_NE(text.find("# TYPE kv_gets counter\n"), string::npos);
+  EXPECT_NE(text.find("kv_gets_total{namespace=\"\"} 1\n"), string::npos);
+  EXPECT_NE(text.find("kv_records{namespace=\"say \\\"hi\\\"\\n\"} 0\n"),
+            string::npos);
+  EXPECT_NE(text.find("kv_writes_admitted_total 0\n"), string::npos);
+  EXPECT_NE(text.find("kv_operation_latency_seconds_bucket{operation=\"get\","
+                      "le=\"+Inf\"} 1\n"),
+            string::npos);
+  EXPECT_NE(text.find("kv_operation_latency_seconds_count{operation=\"get\"} "
+                      "1\n"),
+            string::npos);
+  // Корзина le="1e-09" включает 1 нс, следующая - до 3 нс
+  EXPECT_NE(text.find("le=\"0\""), string::npos);
+  EXPECT_NE(text.find("le=\"1e-09\""), string::npos);
+  EXPECT_NE(text.find("le=\"3e-09\""), string::npos);
+  EXPECT_EQ(text.substr(text.size() - 6), "# EOF\n");
+}
+
+TEST_F(KVStorageTest, LatencyBucketBoundsIncludeTheirValues) {
+  kv_metrics::LatencyHistogram histogram;
+  for (auto ns : {1ns, 2ns, 3ns, 4ns}) {
+    histogram.record(ns);
+  }
+  kv_metrics::Writer out;
+  out.family("lat", "histogram", "");
+  out.histogram({}, histogram.snapshot());
+  auto text = out.finish();
+  EXPECT_NE(text.find("lat_bucket{le=\"0\"} 0\n"), string::npos);
+  EXPECT_NE(text.find("lat_bucket{le=\"1e-09\"} 1\n"), string::npos);
+  EXPECT_NE(text.find("lat_bucket{le=\"3e-09\"} 3\n"), string::npos);
+  EXPECT_NE(text.find("lat_bucket{le=\"7e-09\"} 4\n"), string::npos);
+}
+
+// 23. Истёкшие, но не удалённые записи
+TEST_F(KVStorageTest, ExpiredBacklogFollowsClockAndRemovals) {
+  KVStorage<TestClock> storage({});
+  using Storage = KVStorage<TestClock>;
+  auto size = [](string_view key, string_view value) {
+    return key.size() + value.size() + Storage::kRecordOverhead;
+  };
+  storage.set("a", "1", 10);
+  storage.set("b", "22", 20);
+  storage.set("c", "333", 30);
+  storage.set("forever", "v");
+  EXPECT_EQ(storage.expiredBacklog().records, 0);
+
+  TestClock::advance(20s);
+  auto backlog = storage.expiredBacklog();
+  EXPECT_EQ(backlog.records, 2);
+  EXPECT_EQ(backlog.bytes, size("a", "1") + size("b", "22"));
+
+  // Перезапись истёкшей записи и удаление уменьшают счётчики
+  storage.set("a", "new", 100);
+  storage.remove("b");
+  EXPECT_EQ(storage.expiredBacklog().records, 0);
+  EXPECT_EQ(storage.expiredBacklog().bytes, 0);
+
+  // Запись со сроком в прошлом учитывается сразу
+  storage.setWithDeadline("past", "v", TestClock::now() - 1s);
+  EXPECT_EQ(storage.expiredBacklog().records, 1);
+
+  TestClock::advance(10s);
+  backlog = storage.expiredBacklog();
+  EXPECT_EQ(backlog.records, 2);
+  EXPECT_EQ(backlog.bytes, size("past", "v") + size("c", "333"));
+  while (storage.removeOneExpiredEntry()) {
+  }
+  EXPECT_EQ(storage.expiredBacklog().records, 0);
+  EXPECT_EQ(storage.metrics().namespaces[0].expired_bytes, 0);
+}
+
+TEST_F(KVStorageTest, ExpiredBacklogMatchesModel) {
+  KVStorage<TestClock> storage({});
+  using Storage = KVStorage<TestClock>;
+  map<string, pair<TestClock::time_point, size_t>> model;
+  minstd_rand rng(7);
+  for (int step = 0; step < 5000; ++step) {
+    auto key = "k" + to_string(rng() % 200);
+    switch (rng() % 4) {
+    case 0:
+    case 1: {
+      uint32_t ttl = rng() % 5;
+      string value(rng() % 40, 'v');
+      model.erase(key);
+      if (ttl != 0) {
+        model[key] = {TestClock::now() + seconds(ttl),
+                      key.size() + value.size() + Storage::kRecordOverhead};
+      }
+      storage.set(key, value, ttl);
+      break;
+    }
+    case 2:
+      model.erase(key);
+      storage.remove(key);
+      break;
+    default:
+      TestClock::advance(milliseconds(rng() % 700));
+      if (rng() % 4 == 0) {
+        if (auto removed = storage.removeOneExpiredEntry()) {
+          model.erase(removed->first);
+        }
+      }
+    }
+    if (step % 7 == 0) {
+      ExpiredBacklog expected;
+      for (auto &[_, entry] : model) {
+        if (entry.first <= TestClock::now()) {
+          ++expected.records;
+          expected.bytes += entry.second;
+        }
+      }
+      auto backlog = storage.expiredBacklog();
+      ASSERT_EQ(backlog.records, expected.records) << "step " << step;
+      ASSERT_EQ(backlog.bytes, expected.bytes) << "step " << step;
+    }
+  }
+}
@@ -0,0 +1,100 @@
+// Проверка и вывод содержимого файла в формате kv_format.
+//
+//   kv_dump [--verify] <file>
+//
+// Без --verify печатает все записи, с --verify только итоговую статистику.
+// Код возврата 1, если файл повреждён.
+#include "kv_format.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+void printEscaped(std::string_view s) {
+  for (unsigned char c : s) {
+    if (c >= 0x20 && c < 0x7F && c != '\\') {
+      std::cout << c;
+    } else {
+      char buf[5];
+      std::snprintf(buf, sizeof(buf), "\\x%02X", c);
+      std::cout << buf;
+    }
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  bool verify_only = false;
+  const char *path = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--verify") == 0) {
+      verify_only = true;
+    } else {
+      path = argv[i];
+    }
+  }
+  if (!path) {
+    std::cerr << "usage: " << argv[0] << " [--verify] <file>\n";
+    return 2;
+  }
+
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    std::cerr << path << ": cannot open\n";
+    return 2;
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  std::string data = buffer.str();
+
+  size_t offset = 0;
+  auto status = kv_format::readFileHeader(data, offset);
+  if (status != kv_format::Status::Ok) {
+    std::cerr << path << ": file header: " << kv_format::toString(status)
+              << "\n";
+    return 1;
+  }
+
+  size_t blocks = 0;
+  size_t records = 0;
+  std::vector<kv_format::RecordView> views;
+  while (true) {
+    views.clear();
+    size_t block_offset = offset;
+    status = kv_format::readBlock(data, offset, views);
+    if (status == kv_format::Status::EndOfData) {
+      break;
+    }
+    if (status != kv_format::Status::Ok) {
+      std::cerr << path << ": block " << blocks << " at offset "
+                << block_offset << ": " << kv_format::toString(status)
+                << "\n";
+      return 1;
+    }
+    ++blocks;
+    records += views.size();
+    if (verify_only) {
+      continue;
+    }
+    for (auto &record : views) {
+      std::cout << record.seq << "\t";
+      printEscaped(record.key);
+      std::cout << "\t";
+      printEscaped(record.value);
+      std::cout << "\t" << record.expiry << "\n";
+    }
+  }
+
+  std::cerr << path << ": ok, " << blocks << " blocks, " << records
+            << " records, crc32c "
+            << (kv_format::crc32cHardwareAvailable() ? "sse4.2" : "software")
+            << "\n";
+  return 0;
+}
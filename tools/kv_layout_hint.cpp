@@ -0,0 +1,44 @@
+// Построение подсказки для KVStorage::relayout по трассе обращений.
+//
+//   kv_layout_hint [--window N] <trace> <hint>
+//
+// trace - последовательности ключей, сохранённые kv_access::saveSequences
+// из KVStorage::accessRecorder(). В hint записываются ключи в порядке
+// размещения: совместно читаемые подряд.
+#include "kv_access.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char **argv) {
+  size_t window = 4;
+  std::vector<const char *> paths;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+      window = std::strtoull(argv[++i], nullptr, 10);
+    } else {
+      paths.push_back(argv[i]);
+    }
+  }
+  if (paths.size() != 2 || window < 2) {
+    std::cerr << "usage: " << argv[0] << " [--window N] <trace> <hint>\n";
+    return 2;
+  }
+
+  std::vector<std::vector<std::string>> sequences;
+  if (auto error = kv_access::loadSequences(paths[0], sequences)) {
+    std::cerr << paths[0] << ": " << error.message() << "\n";
+    return 1;
+  }
+  auto order = kv_access::buildLayout(sequences, window);
+  if (auto error = kv_access::saveHint(paths[1], order)) {
+    std::cerr << paths[1] << ": " << error.message() << "\n";
+    return 1;
+  }
+  std::cout << sequences.size() << " sequences, " << order.size()
+            << " keys in hint\n";
+  return 0;
+}